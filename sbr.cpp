@@ -6,6 +6,83 @@
 #include <sstream>
 #include <algorithm> // Para std::transform y std::remove
 #include <cctype>    // Para std::tolower y std::isspace
+#include <unordered_map>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <array>
+#include <limits>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SBR_POSIX 1
+#endif
+
+// Lectura masiva de ficheros de hechos con io_uring (Linux 5.6 o posterior), por llamadas al
+// sistema directas. Con -DSBR_SIN_IO_URING, o sin la cabecera, se leen uno tras otro.
+#if defined(__linux__) && !defined(SBR_SIN_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define SBR_IO_URING 1
+#endif
+#endif
+
+// Contadores de fallos de caché del benchmark con perf_event_open (Linux). Con -DSBR_SIN_PERF,
+// o sin la cabecera, el benchmark los da como n/a.
+#if defined(__linux__) && !defined(SBR_SIN_PERF) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define SBR_PERF 1
+#endif
+#endif
+
+// Compilación: g++ -std=c++17 -O2 -pthread sbr.cpp -o sbr
+
+// Sondas USDT (proveedor "sbr") para bpftrace y perf. Si <sys/sdt.h> está disponible cada
+// sonda queda como un nop más una nota ELF, sin dependencias en ejecución; si no lo está,
+// o se compila con -DSBR_SIN_USDT, las macros no generan código.
+//   carga_reglas_inicio(fichero)          carga_reglas_fin(fichero, numReglas, ok)
+//   consulta_inicio(objetivo)             consulta_fin(objetivo, fc * 1e6)
+//   regla_disparo(reglaFichero, simbolo)  memo_fallo(simbolo)
+#if !defined(SBR_SIN_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SBR_USDT 1
+#endif
+#endif
+#ifdef SBR_USDT
+#define SBR_SONDA1(nombre, a) DTRACE_PROBE1(sbr, nombre, a)
+#define SBR_SONDA2(nombre, a, b) DTRACE_PROBE2(sbr, nombre, a, b)
+#define SBR_SONDA3(nombre, a, b, c) DTRACE_PROBE3(sbr, nombre, a, b, c)
+#else
+#define SBR_SONDA1(nombre, a) do {} while (0)
+#define SBR_SONDA2(nombre, a, b) do {} while (0)
+#define SBR_SONDA3(nombre, a, b, c) do {} while (0)
+#endif
 
 // --- Definición de Estructuras de Datos ---
 
@@ -13,6 +90,8 @@
 struct Hecho {
     std::string nombre;
     double factorCerteza = 0.0; // Se establece al leer de BH o al inferir.
+    bool numerico = false;      // Hecho "atributo=valor": nombre es el atributo
+    double valor = 0.0;
 };
 
 // Operadores lógicos para las condiciones de las reglas
@@ -34,6 +113,7 @@ struct Regla {
     Antecedente antecedente;
     Hecho consecuente;
     double factorCertezaRegla; // FC de la implicación de la regla
+    int prioridad = 0;         // Saliencia para el encadenamiento hacia delante (", prioridad=N")
 };
 
 // Contenedor para la Base de Conocimiento
@@ -46,6 +126,7 @@ struct BaseHechos {
     std::vector<Hecho> hechos_iniciales;
     Hecho objetivo;
     std::map<std::string, double> fc_memoria; // Memoria de trabajo (FCs conocidos o inferidos)
+    std::map<std::string, Hecho> valores;     // Hechos numéricos por atributo
 };
 
 // --- Funciones Auxiliares para Parseo ---
@@ -67,6 +148,117 @@ std::string trim(const std::string& str) {
     return str.substr(start, (end - start + 1));
 }
 
+// Elimina los espacios alrededor de '=' para aceptar tanto "FC=0.5" como "FC = 0.5"
+std::string quitarEspaciosIgual(const std::string& str) {
+    std::string res;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '=') {
+            while (!res.empty() && std::isspace(static_cast<unsigned char>(res.back()))) res.pop_back();
+            res += '=';
+            while (i + 1 < str.size() && std::isspace(static_cast<unsigned char>(str[i + 1]))) ++i;
+        } else {
+            res += str[i];
+        }
+    }
+    return res;
+}
+
+// Literal de comparación "atributo op umbral" (p. ej. "temperatura > 38"). Con el atributo
+// conocido vale FC del hecho numérico si se cumple y -FC si no; si no, es un hecho más.
+enum class OperadorComparacion { MENOR, MENOR_IGUAL, IGUAL, MAYOR_IGUAL, MAYOR };
+
+struct Comparacion {
+    std::string atributo;
+    OperadorComparacion operador = OperadorComparacion::IGUAL;
+    double umbral = 0.0;
+    std::string canonico; // Nombre del literal sin espacios: "temperatura>38"
+};
+
+static bool esNumeroCompleto(const std::string& texto, double& valor) {
+    try {
+        size_t leidos = 0;
+        valor = std::stod(texto, &leidos);
+        return leidos == texto.size() && std::isfinite(valor);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Devuelve false si el texto no es una comparación (entonces es un nombre de hecho normal)
+bool parsearComparacion(const std::string& texto, Comparacion& comp) {
+    size_t pos = texto.find_first_of("<>=");
+    if (pos == std::string::npos || pos == 0) return false;
+    size_t longitud = 1;
+    if (texto[pos] == '=') comp.operador = OperadorComparacion::IGUAL;
+    else if (pos + 1 < texto.size() && texto[pos + 1] == '=') {
+        comp.operador = texto[pos] == '<' ? OperadorComparacion::MENOR_IGUAL : OperadorComparacion::MAYOR_IGUAL;
+        longitud = 2;
+    } else {
+        comp.operador = texto[pos] == '<' ? OperadorComparacion::MENOR : OperadorComparacion::MAYOR;
+    }
+    comp.atributo = trim(texto.substr(0, pos));
+    std::string umbral = trim(texto.substr(pos + longitud));
+    if (comp.atributo.empty() || !esNumeroCompleto(umbral, comp.umbral)) return false;
+    comp.canonico = comp.atributo + texto.substr(pos, longitud) + umbral;
+    return true;
+}
+
+bool cumpleComparacion(OperadorComparacion operador, double valor, double umbral) {
+    switch (operador) {
+        case OperadorComparacion::MENOR: return valor < umbral;
+        case OperadorComparacion::MENOR_IGUAL: return valor <= umbral;
+        case OperadorComparacion::IGUAL: return valor == umbral;
+        case OperadorComparacion::MAYOR_IGUAL: return valor >= umbral;
+        case OperadorComparacion::MAYOR: return valor > umbral;
+    }
+    return false;
+}
+
+// Átomo "predicado(arg1, ..., argN)". Un argumento que empieza por mayúscula o '_' es una
+// variable; los demás son constantes. Un nombre sin paréntesis es un átomo sin argumentos.
+struct Atomo {
+    std::string predicado;
+    std::vector<std::string> argumentos;
+};
+
+bool esVariable(const std::string& termino) {
+    return !termino.empty() && (std::isupper(static_cast<unsigned char>(termino[0])) || termino[0] == '_');
+}
+
+Atomo parsearAtomo(const std::string& nombre) {
+    Atomo a;
+    size_t abre = nombre.find('(');
+    if (abre == std::string::npos || nombre.back() != ')') {
+        a.predicado = nombre;
+        return a;
+    }
+    a.predicado = trim(nombre.substr(0, abre));
+    std::string argumentos = nombre.substr(abre + 1, nombre.size() - abre - 2);
+    size_t inicio = 0;
+    while (true) {
+        size_t coma = argumentos.find(',', inicio);
+        a.argumentos.push_back(trim(argumentos.substr(inicio, coma == std::string::npos ? std::string::npos : coma - inicio)));
+        if (coma == std::string::npos) break;
+        inicio = coma + 1;
+    }
+    return a;
+}
+
+// Nombre canónico del átomo, sin espacios alrededor de los argumentos: "padre(juan,ana)"
+std::string nombreAtomo(const Atomo& a) {
+    if (a.argumentos.empty()) return a.predicado;
+    std::string nombre = a.predicado + "(";
+    for (size_t i = 0; i < a.argumentos.size(); ++i) {
+        if (i > 0) nombre += ',';
+        nombre += a.argumentos[i];
+    }
+    return nombre + ")";
+}
+
+std::string normalizarAtomo(const std::string& nombre) {
+    return nombre.find('(') == std::string::npos ? nombre : nombreAtomo(parsearAtomo(nombre));
+}
+
 // Parsea la cadena del antecedente para extraer los hechos y el operador
 bool parsearAntecedente(const std::string& alfaStr, Antecedente& antecedente) {
     std::string alfaLower = toLower(alfaStr);
@@ -103,7 +295,8 @@ bool parsearAntecedente(const std::string& alfaStr, Antecedente& antecedente) {
     for (const auto& litStr : literalesStr) {
         if (!litStr.empty()) {
             Hecho h;
-            h.nombre = litStr;
+            Comparacion comp;
+            h.nombre = parsearComparacion(litStr, comp) ? comp.canonico : normalizarAtomo(litStr);
             // h.factorCerteza no se establece aquí, se buscará/inferirá
             antecedente.condiciones.push_back(h);
         } else {
@@ -115,15 +308,159 @@ bool parsearAntecedente(const std::string& alfaStr, Antecedente& antecedente) {
 }
 
 
-// --- Funciones de Carga ---
+// --- Plantillas de Reglas ---
 
-bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
-    std::ifstream archivo(nombreArchivo);
-    if (!archivo.is_open()) {
-        std::cerr << "Error al abrir el archivo de reglas: " << nombreArchivo << std::endl;
+// "R1[k=1..100]: Si sensor{k} alto Entonces alarma{k}, FC=0.8" es una sola línea del fichero
+// que equivale a las reglas R1[1]..R1[100]. En los nombres, {k}, {k+c} y {k-c} se sustituyen
+// por el valor del parámetro. La línea se parsea una vez y en cada valor sólo se construyen
+// los nombres, sin generar ni volver a parsear el texto de cada regla.
+
+// Cabecera "id[variable=desde..hasta]" de una plantilla
+struct RangoPlantilla {
+    std::string id;
+    std::string variable;
+    long desde = 0;
+    long hasta = 0;
+};
+
+// Un trozo literal o una referencia al parámetro (más un desplazamiento) dentro de un nombre
+struct TrozoNombre {
+    std::string literal;
+    bool parametro = false;
+    long desplazamiento = 0;
+};
+
+#if defined(SBR_FUZZ_REGLAS) || defined(SBR_FUZZ_BUFFER)
+static const long kMaxInstanciasPlantilla = 1L << 8; // Que el fuzzer no se pierda en expansiones enormes
+#else
+static const long kMaxInstanciasPlantilla = 1L << 20;
+#endif
+
+// Un id con "[...=...]" al final es una plantilla (un id expandido como "R1[3]" no lo es)
+bool esCabeceraPlantilla(const std::string& id) {
+    size_t abre = id.find('[');
+    return abre != std::string::npos && id.back() == ']' && id.find('=', abre) != std::string::npos;
+}
+
+bool parsearCabeceraPlantilla(const std::string& id, RangoPlantilla& rango) {
+    size_t abre = id.find('[');
+    size_t igual = id.find('=', abre);
+    size_t puntos = id.find("..", igual);
+    if (puntos == std::string::npos) {
+        std::cerr << "Error de formato en plantilla (se esperaba 'variable=desde..hasta'): " << id << std::endl;
+        return false;
+    }
+    rango.id = trim(id.substr(0, abre));
+    rango.variable = trim(id.substr(abre + 1, igual - abre - 1));
+    try {
+        rango.desde = std::stol(trim(id.substr(igual + 1, puntos - igual - 1)));
+        rango.hasta = std::stol(trim(id.substr(puntos + 2, id.size() - 1 - (puntos + 2))));
+    } catch (const std::exception&) {
+        std::cerr << "Error: Rango de plantilla inválido: " << id << std::endl;
+        return false;
+    }
+    if (rango.id.empty() || rango.variable.empty() || rango.desde > rango.hasta ||
+        static_cast<unsigned long>(rango.hasta) - static_cast<unsigned long>(rango.desde) >=
+            static_cast<unsigned long>(kMaxInstanciasPlantilla)) { // Sin signo: la resta en long puede desbordar
+        std::cerr << "Error: Rango de plantilla inválido: " << id << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Parte un nombre en trozos literales y referencias {variable}, {variable+c} o {variable-c}
+bool compilarNombrePlantilla(const std::string& nombre, const std::string& variable, std::vector<TrozoNombre>& trozos) {
+    size_t pos = 0;
+    while (pos < nombre.size()) {
+        size_t abre = nombre.find('{', pos);
+        if (abre == std::string::npos) {
+            trozos.push_back({nombre.substr(pos), false, 0});
+            break;
+        }
+        size_t cierra = nombre.find('}', abre);
+        if (cierra == std::string::npos) {
+            std::cerr << "Error: Falta '}' en el nombre de plantilla: " << nombre << std::endl;
+            return false;
+        }
+        if (abre > pos) trozos.push_back({nombre.substr(pos, abre - pos), false, 0});
+        std::string expresion = trim(nombre.substr(abre + 1, cierra - abre - 1));
+        TrozoNombre referencia;
+        referencia.parametro = true;
+        bool valida = expresion.compare(0, variable.size(), variable) == 0;
+        std::string resto = valida ? trim(expresion.substr(variable.size())) : "";
+        if (valida && !resto.empty()) {
+            valida = (resto[0] == '+' || resto[0] == '-') && resto.size() > 1;
+            try {
+                size_t leidos = 0;
+                if (valida) referencia.desplazamiento = std::stol(resto, &leidos);
+                valida = valida && leidos == resto.size();
+            } catch (const std::exception&) {
+                valida = false;
+            }
+        }
+        if (!valida) {
+            std::cerr << "Error: Referencia '{" << expresion << "}' desconocida en la plantilla (parámetro '"
+                      << variable << "'): " << nombre << std::endl;
+            return false;
+        }
+        trozos.push_back(referencia);
+        pos = cierra + 1;
+    }
+    return true;
+}
+
+// Que valor + desplazamiento no desborde long para ningún valor del rango
+static bool desplazamientosEnRango(const std::vector<TrozoNombre>& trozos, const RangoPlantilla& rango) {
+    for (const auto& t : trozos) {
+        if (!t.parametro) continue;
+        if (t.desplazamiento > 0 && rango.hasta > std::numeric_limits<long>::max() - t.desplazamiento) return false;
+        if (t.desplazamiento < 0 && rango.desde < std::numeric_limits<long>::min() - t.desplazamiento) return false;
+    }
+    return true;
+}
+
+static std::string instanciarNombre(const std::vector<TrozoNombre>& trozos, long valor) {
+    std::string nombre;
+    for (const auto& t : trozos) {
+        if (t.parametro) nombre += std::to_string(valor + t.desplazamiento);
+        else nombre += t.literal;
+    }
+    return nombre;
+}
+
+// Añade a la BC una regla por cada valor del rango de la plantilla
+bool expandirPlantilla(const Regla& plantilla, const RangoPlantilla& rango, BaseConocimiento& bc) {
+    std::vector<std::vector<TrozoNombre>> condiciones(plantilla.antecedente.condiciones.size());
+    std::vector<TrozoNombre> consecuente;
+    for (size_t c = 0; c < condiciones.size(); ++c) {
+        if (!compilarNombrePlantilla(plantilla.antecedente.condiciones[c].nombre, rango.variable, condiciones[c])) return false;
+    }
+    if (!compilarNombrePlantilla(plantilla.consecuente.nombre, rango.variable, consecuente)) return false;
+    bool enRango = desplazamientosEnRango(consecuente, rango);
+    for (const auto& trozos : condiciones) enRango = enRango && desplazamientosEnRango(trozos, rango);
+    if (!enRango) {
+        std::cerr << "Error: Un desplazamiento de la plantilla se sale del rango de enteros: " << rango.id << std::endl;
         return false;
     }
 
+    bc.reglas.reserve(bc.reglas.size() + (rango.hasta - rango.desde + 1));
+    for (long k = rango.desde; k <= rango.hasta; ++k) {
+        Regla r;
+        r.id = rango.id + "[" + std::to_string(k) + "]";
+        r.antecedente.operador = plantilla.antecedente.operador;
+        r.antecedente.condiciones.resize(condiciones.size());
+        for (size_t c = 0; c < condiciones.size(); ++c) r.antecedente.condiciones[c].nombre = instanciarNombre(condiciones[c], k);
+        r.consecuente.nombre = instanciarNombre(consecuente, k);
+        r.factorCertezaRegla = plantilla.factorCertezaRegla;
+        r.prioridad = plantilla.prioridad;
+        bc.reglas.push_back(std::move(r));
+    }
+    return true;
+}
+
+// --- Funciones de Carga ---
+
+bool cargarReglas(std::istream& archivo, BaseConocimiento& bc) {
     std::string linea;
     int numReglasEsperadas = 0;
 
@@ -131,7 +468,7 @@ bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
     if (std::getline(archivo, linea)) {
         try {
             numReglasEsperadas = std::stoi(trim(linea));
-        } catch (const std::invalid_argument& ia) {
+        } catch (const std::exception&) { // invalid_argument u out_of_range
             std::cerr << "Error: Número de reglas inválido: " << linea << std::endl;
             return false;
         }
@@ -146,7 +483,7 @@ bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
             return false;
         }
 
-        linea = trim(linea);
+        linea = quitarEspaciosIgual(trim(linea));
         if (linea.empty()) { // Omitir líneas vacías si las hubiera, aunque no deberían
             i--;
             continue;
@@ -161,8 +498,31 @@ bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
             return false;
         }
         r.id = trim(linea.substr(0, posColon));
+        RangoPlantilla rango;
+        bool plantilla = esCabeceraPlantilla(r.id);
+        if (plantilla && !parsearCabeceraPlantilla(r.id, rango)) return false;
         std::string defReglaCompleta = trim(linea.substr(posColon + 1));
 
+        // 2a. Prioridad opcional al final: "..., FC=0.5, prioridad=3"
+        size_t posPrioridad = toLower(defReglaCompleta).rfind("prioridad=");
+        if (posPrioridad != std::string::npos) {
+            size_t posComa = defReglaCompleta.rfind(',', posPrioridad);
+            if (posComa != std::string::npos && trim(defReglaCompleta.substr(posComa + 1, posPrioridad - posComa - 1)).empty()) {
+                std::string prioridadStr = trim(defReglaCompleta.substr(posPrioridad + 10));
+                size_t usados = 0;
+                try {
+                    r.prioridad = std::stoi(prioridadStr, &usados);
+                } catch (const std::exception&) {
+                    usados = 0;
+                }
+                if (usados == 0 || usados != prioridadStr.size()) {
+                    std::cerr << "Error: Prioridad de regla inválida: " << prioridadStr << " en " << defReglaCompleta << std::endl;
+                    return false;
+                }
+                defReglaCompleta = trim(defReglaCompleta.substr(0, posComa));
+            }
+        }
+
         // 2. Extraer Factor de Certeza de la regla
         std::string fcMarkerLower = "fc=";
         std::string defReglaLower = toLower(defReglaCompleta);
@@ -183,7 +543,8 @@ bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
         std::string fcValorStr = trim(defReglaCompleta.substr(posFc + fcMarkerLower.length()));
         try {
             r.factorCertezaRegla = std::stod(fcValorStr);
-        } catch (const std::invalid_argument& ia) {
+            if (!std::isfinite(r.factorCertezaRegla)) throw std::invalid_argument(fcValorStr); // "nan", "inf"
+        } catch (const std::exception&) { // invalid_argument u out_of_range
             std::cerr << "Error: Factor de certeza de regla inválido: " << fcValorStr << " en " << defReglaCompleta << std::endl;
             return false;
         }
@@ -226,26 +587,39 @@ bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
         }
 
         // Parsear consecuente (es un solo Hecho)
-        r.consecuente.nombre = trim(betaStr);
+        r.consecuente.nombre = normalizarAtomo(trim(betaStr));
         // r.consecuente.factorCerteza no se establece aquí
 
-        bc.reglas.push_back(r);
-    }
-    if (bc.reglas.size() != numReglasEsperadas) {
-        std::cerr << "Advertencia: Se esperaban " << numReglasEsperadas << " reglas, pero se cargaron " << bc.reglas.size() << "." << std::endl;
+        if (plantilla) {
+            if (!expandirPlantilla(r, rango, bc)) {
+                std::cerr << "Error al expandir la plantilla: " << r.id << std::endl;
+                return false;
+            }
+        } else {
+            bc.reglas.push_back(r);
+        }
     }
 
 
     return true;
 }
 
-bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
+bool cargarReglas(const std::string& nombreArchivo, BaseConocimiento& bc) {
+    SBR_SONDA1(carga_reglas_inicio, nombreArchivo.c_str());
     std::ifstream archivo(nombreArchivo);
-    if (!archivo.is_open()) {
-        std::cerr << "Error al abrir el archivo de hechos: " << nombreArchivo << std::endl;
-        return false;
+    bool ok = archivo.is_open();
+    if (!ok) {
+        std::cerr << "Error al abrir el archivo de reglas: " << nombreArchivo << std::endl;
+    } else {
+        ok = cargarReglas(archivo, bc);
     }
+    SBR_SONDA3(carga_reglas_fin, nombreArchivo.c_str(), bc.reglas.size(), ok);
+    return ok;
+}
 
+// Lee un bloque "número / hechos / Objetivo / objetivo" y deja el flujo justo detrás,
+// de modo que un fichero de casos concatenados se lee con llamadas sucesivas
+bool cargarHechos(std::istream& archivo, BaseHechos& bh) {
     std::string linea;
     int numHechosEsperados = 0;
 
@@ -253,7 +627,7 @@ bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
     if (std::getline(archivo, linea)) {
         try {
             numHechosEsperados = std::stoi(trim(linea));
-        } catch (const std::invalid_argument& ia) {
+        } catch (const std::exception&) { // invalid_argument u out_of_range
             std::cerr << "Error: Número de hechos inválido: " << linea << std::endl;
             return false;
         }
@@ -267,7 +641,7 @@ bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
             std::cerr << "Error: Fin de archivo inesperado. Se esperaban " << numHechosEsperados << " hechos, se leyeron " << i << "." << std::endl;
             return false;
         }
-        linea = trim(linea);
+        linea = quitarEspaciosIgual(trim(linea));
          if (linea.empty()) {
             i--;
             continue;
@@ -286,6 +660,20 @@ bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
 
         h.nombre = trim(linea.substr(0, posComa));
         std::string fcParte = trim(linea.substr(posComa + 1));
+
+        // "atributo=valor" es un hecho numérico; "atributo > umbral" el valor de un literal
+        Comparacion comp;
+        if (parsearComparacion(h.nombre, comp)) {
+            if (comp.operador == OperadorComparacion::IGUAL && comp.atributo.find_first_of("<>!") == std::string::npos) {
+                h.nombre = comp.atributo;
+                h.numerico = true;
+                h.valor = comp.umbral;
+            } else {
+                h.nombre = comp.canonico;
+            }
+        } else {
+            h.nombre = normalizarAtomo(h.nombre);
+        }
         std::string fcParteLower = toLower(fcParte);
         
         size_t posFc = fcParteLower.find(fcMarkerLower);
@@ -297,13 +685,15 @@ bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
         std::string fcValorStr = trim(fcParte.substr(posFc + fcMarkerLower.length()));
         try {
             h.factorCerteza = std::stod(fcValorStr);
-        } catch (const std::invalid_argument& ia) {
+            if (!std::isfinite(h.factorCerteza)) throw std::invalid_argument(fcValorStr); // "nan", "inf"
+        } catch (const std::exception&) { // invalid_argument u out_of_range
             std::cerr << "Error: Factor de certeza de hecho inválido: " << fcValorStr << " en " << linea << std::endl;
             return false;
         }
 
         bh.hechos_iniciales.push_back(h);
-        bh.fc_memoria[h.nombre] = h.factorCerteza;
+        if (h.numerico) bh.valores[h.nombre] = h;
+        else bh.fc_memoria[h.nombre] = h.factorCerteza;
     }
 
     if (bh.hechos_iniciales.size() != numHechosEsperados) {
@@ -325,7 +715,7 @@ bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
                 return false;
             }
         } else {
-            bh.objetivo.nombre = trim(linea);
+            bh.objetivo.nombre = normalizarAtomo(trim(linea));
             // bh.objetivo.factorCerteza se calculará
             if (bh.objetivo.nombre.empty()) {
                 std::cerr << "Error: Hecho objetivo no especificado o vacío." << std::endl;
@@ -348,6 +738,409 @@ bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
 }
 
 
+bool cargarHechos(const std::string& nombreArchivo, BaseHechos& bh) {
+    std::ifstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de hechos: " << nombreArchivo << std::endl;
+        return false;
+    }
+    return cargarHechos(archivo, bh);
+}
+
+// Carga todos los casos de un fichero de bloques de hechos concatenados
+bool cargarCasos(const std::string& nombreArchivo, std::vector<BaseHechos>& casos) {
+    std::ifstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de casos: " << nombreArchivo << std::endl;
+        return false;
+    }
+    while (archivo >> std::ws && archivo.peek() != std::char_traits<char>::eof()) {
+        casos.emplace_back();
+        if (!cargarHechos(archivo, casos.back())) {
+            std::cerr << "Error en el caso " << casos.size() << " de " << nombreArchivo << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Vista de un buffer en memoria como std::istream, sin copiarlo
+class BufferMemoria : public std::streambuf {
+public:
+    BufferMemoria(const char* datos, size_t tamano) {
+        char* inicio = const_cast<char*>(datos); // Sólo se lee: no hay área de escritura
+        setg(inicio, inicio, inicio + tamano);
+    }
+};
+
+// Variantes sobre un buffer en memoria (fichero mapeado, bloque leído en bloque, etc.)
+bool cargarReglasDesdeBuffer(const char* datos, size_t tamano, BaseConocimiento& bc) {
+    BufferMemoria buffer(datos, tamano);
+    std::istream flujo(&buffer);
+    return cargarReglas(flujo, bc);
+}
+
+bool cargarHechosDesdeBuffer(const char* datos, size_t tamano, BaseHechos& bh) {
+    BufferMemoria buffer(datos, tamano);
+    std::istream flujo(&buffer);
+    return cargarHechos(flujo, bh);
+}
+
+
+// --- Lectura Masiva de Ficheros de Hechos ---
+
+// Un archivo de casos puede ser un directorio con millones de ficheros .hechos pequeños. Abrir,
+// leer y cerrar cada uno con un ifstream bloquea tres veces por fichero; con io_uring las
+// aperturas, lecturas y cierres de `profundidad` ficheros están en vuelo a la vez y cada
+// fichero leído se entrega al parser de buffers en cuanto se completa.
+
+// Recibe cada fichero leído: su índice en la lista de rutas y su contenido. false si es inválido.
+using EntregaFichero = std::function<bool(size_t, const char*, size_t)>;
+
+// Rutas de los casos: los ficheros .hechos de un directorio, en orden de nombre, o las líneas
+// no vacías de un fichero lista
+bool listarFicherosHechos(const std::string& ruta, std::vector<std::string>& rutas) {
+#ifdef SBR_POSIX
+    struct stat info;
+    if (stat(ruta.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(ruta.c_str());
+        if (!dir) {
+            std::cerr << "Error al abrir el directorio de casos: " << ruta << std::endl;
+            return false;
+        }
+        const std::string extension = ".hechos";
+        while (dirent* entrada = readdir(dir)) {
+            std::string nombre = entrada->d_name;
+            if (nombre.size() > extension.size() &&
+                nombre.compare(nombre.size() - extension.size(), extension.size(), extension) == 0) {
+                rutas.push_back(ruta + "/" + nombre);
+            }
+        }
+        closedir(dir);
+        std::sort(rutas.begin(), rutas.end());
+        return true;
+    }
+#endif
+    std::ifstream lista(ruta);
+    if (!lista.is_open()) {
+        std::cerr << "Error al abrir la lista de casos: " << ruta << std::endl;
+        return false;
+    }
+    std::string linea;
+    while (std::getline(lista, linea)) {
+        linea = trim(linea);
+        if (!linea.empty()) rutas.push_back(linea);
+    }
+    return true;
+}
+
+static bool leerFicherosSecuencial(const std::vector<std::string>& rutas, const EntregaFichero& entregar) {
+    bool correcto = true;
+    std::string datos;
+    for (size_t i = 0; i < rutas.size(); ++i) {
+        std::ifstream archivo(rutas[i], std::ios::binary);
+        if (!archivo.is_open()) {
+            std::cerr << "Error al abrir el archivo de hechos: " << rutas[i] << std::endl;
+            correcto = false;
+            continue;
+        }
+        datos.assign(std::istreambuf_iterator<char>(archivo), std::istreambuf_iterator<char>());
+        if (!entregar(i, datos.data(), datos.size())) correcto = false;
+    }
+    return correcto;
+}
+
+#ifdef SBR_IO_URING
+// Anillo io_uring sobre las llamadas al sistema, sin liburing. Un solo hilo prepara las
+// entradas y recoge las completadas, así que basta con ordenar las colas compartidas con el
+// núcleo (adquisición al leer lo que escribe él, liberación al publicar lo nuestro).
+class AnilloIoUring {
+public:
+    AnilloIoUring() = default;
+    AnilloIoUring(const AnilloIoUring&) = delete;
+    AnilloIoUring& operator=(const AnilloIoUring&) = delete;
+    ~AnilloIoUring() { cerrar(); }
+
+    bool abrir(unsigned entradas) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        long fd = syscall(__NR_io_uring_setup, entradas, &p);
+        if (fd < 0) return false;
+        fd_ = static_cast<int>(fd);
+        tamSq_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        tamCq_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool unico = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (unico) tamSq_ = tamCq_ = std::max(tamSq_, tamCq_);
+        sq_ = mapear(tamSq_, IORING_OFF_SQ_RING);
+        cq_ = unico ? sq_ : mapear(tamCq_, IORING_OFF_CQ_RING);
+        tamSqes_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mapear(tamSqes_, IORING_OFF_SQES));
+        if (!sq_ || !cq_ || !sqes_) {
+            cerrar();
+            return false;
+        }
+        char* sq = static_cast<char*>(sq_);
+        char* cq = static_cast<char*>(cq_);
+        sqCabeza_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sqCola_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMascara_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqCabeza_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqCola_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMascara_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        entradas_ = p.sq_entries;
+        colaLocal_ = enviadas_ = *sqCola_;
+        if (!admiteOperaciones()) {
+            cerrar();
+            errno = EOPNOTSUPP;
+            return false;
+        }
+        return true;
+    }
+
+    // Buffers fijos: el núcleo los fija en memoria una vez en lugar de en cada lectura
+    bool registrarBuffers(const std::vector<iovec>& buffers) {
+        return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers.data(),
+                       static_cast<unsigned>(buffers.size())) == 0;
+    }
+
+    // Siguiente entrada libre, a cero; nullptr si la cola de envío está llena
+    io_uring_sqe* siguienteSqe() {
+        if (colaLocal_ - __atomic_load_n(sqCabeza_, __ATOMIC_ACQUIRE) >= entradas_) return nullptr;
+        unsigned i = colaLocal_ & sqMascara_;
+        io_uring_sqe* sqe = &sqes_[i];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[i] = i;
+        ++colaLocal_;
+        return sqe;
+    }
+
+    // Envía las entradas preparadas y espera a que haya al menos `minimo` completadas
+    bool enviar(unsigned minimo) {
+        __atomic_store_n(sqCola_, colaLocal_, __ATOMIC_RELEASE);
+        while (true) {
+            long enviadas = syscall(__NR_io_uring_enter, fd_, colaLocal_ - enviadas_, minimo,
+                                    minimo ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (enviadas >= 0) {
+                enviadas_ += static_cast<unsigned>(enviadas);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    bool completada(io_uring_cqe& cqe) {
+        unsigned cabeza = *cqCabeza_;
+        if (cabeza == __atomic_load_n(cqCola_, __ATOMIC_ACQUIRE)) return false;
+        cqe = cqes_[cabeza & cqMascara_];
+        __atomic_store_n(cqCabeza_, cabeza + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    // io_uring_setup existe desde Linux 5.1, pero OPENAT y CLOSE son de 5.6 y en los núcleos
+    // intermedios cada entrada se completaría con -EINVAL. Sin IORING_REGISTER_PROBE (también
+    // de 5.6) se da por hecho que faltan.
+    bool admiteOperaciones() {
+        const unsigned kOperaciones = 256;
+        std::vector<char> memoria(sizeof(io_uring_probe) + kOperaciones * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* sonda = reinterpret_cast<io_uring_probe*>(memoria.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, sonda, kOperaciones) != 0) return false;
+        for (unsigned op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE}) {
+            if (op > sonda->last_op || !(sonda->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    void* mapear(size_t tamano, uint64_t desplazamiento) {
+        void* p = mmap(nullptr, tamano, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                       static_cast<off_t>(desplazamiento));
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void cerrar() {
+        if (sqes_) munmap(sqes_, tamSqes_);
+        if (cq_ && cq_ != sq_) munmap(cq_, tamCq_);
+        if (sq_) munmap(sq_, tamSq_);
+        if (fd_ >= 0) close(fd_);
+        sqes_ = nullptr;
+        sq_ = cq_ = nullptr;
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void* sq_ = nullptr;
+    void* cq_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t tamSq_ = 0, tamCq_ = 0, tamSqes_ = 0;
+    unsigned* sqCabeza_ = nullptr;
+    unsigned* sqCola_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMascara_ = 0;
+    unsigned* cqCabeza_ = nullptr;
+    unsigned* cqCola_ = nullptr;
+    unsigned cqMascara_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned entradas_ = 0;
+    unsigned colaLocal_ = 0; // Cola de envío con las entradas preparadas aún sin publicar
+    unsigned enviadas_ = 0;  // Entradas ya entregadas al núcleo
+};
+
+// Cada fichero ocupa un hueco (buffer fijo) desde que se abre hasta que se entrega: apertura,
+// lectura de hasta kHueco bytes y cierre, encadenados por las completadas. Un fichero que llena
+// el hueco se termina de leer con pread (los .hechos de un caso rara vez pasan de unos KB).
+static bool leerConIoUring(AnilloIoUring& anillo, const std::vector<std::string>& rutas, unsigned profundidad,
+                           const EntregaFichero& entregar) {
+    const size_t kHueco = 64 * 1024;
+    enum Fase : uint64_t { ABRIR, LEER, CERRAR };
+    std::vector<char> memoria(profundidad * kHueco);
+    std::vector<iovec> buffers(profundidad);
+    for (unsigned h = 0; h < profundidad; ++h) buffers[h] = {memoria.data() + h * kHueco, kHueco};
+    bool fijos = anillo.registrarBuffers(buffers);
+
+    std::vector<size_t> fichero(profundidad);
+    std::vector<int> descriptor(profundidad, -1);
+    std::vector<unsigned> libres;
+    for (unsigned h = profundidad; h-- > 0;) libres.push_back(h);
+    auto nuevaEntrada = [&](unsigned h, Fase fase) {
+        io_uring_sqe* sqe = anillo.siguienteSqe();
+        if (!sqe && anillo.enviar(0)) sqe = anillo.siguienteSqe();
+        if (sqe) sqe->user_data = (static_cast<uint64_t>(h) << 2) | fase;
+        return sqe;
+    };
+
+    // Ante un error de io_uring no se envían más ficheros, pero se esperan las entradas en
+    // vuelo antes de volver: sus lecturas escriben en `memoria` y sus descriptores hay que cerrarlos
+    size_t siguiente = 0;
+    unsigned enVuelo = 0;
+    bool correcto = true, abortar = false;
+    std::string completo;
+    auto cerrarDescriptor = [&](unsigned h) {
+        if (descriptor[h] < 0) return;
+        io_uring_sqe* sqe = abortar ? nullptr : nuevaEntrada(h, CERRAR);
+        if (sqe) {
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = descriptor[h];
+            ++enVuelo;
+        } else {
+            close(descriptor[h]);
+        }
+        descriptor[h] = -1;
+    };
+    while ((!abortar && siguiente < rutas.size()) || enVuelo > 0) {
+        while (!abortar && !libres.empty() && siguiente < rutas.size()) {
+            unsigned h = libres.back();
+            io_uring_sqe* sqe = nuevaEntrada(h, ABRIR);
+            if (!sqe) break;
+            libres.pop_back();
+            fichero[h] = siguiente++;
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(rutas[fichero[h]].c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            ++enVuelo;
+        }
+        if (enVuelo == 0) {
+            std::cerr << "Error: io_uring: cola de envío agotada: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (!anillo.enviar(1)) {
+            std::cerr << "Error: io_uring_enter: " << std::strerror(errno) << std::endl;
+            // Sin io_uring_enter no se sabe cuándo terminan las lecturas pendientes: los huecos
+            // se quedan sin liberar antes que liberarlos con el núcleo escribiendo en ellos
+            new std::vector<char>(std::move(memoria));
+            for (unsigned h = 0; h < profundidad; ++h) {
+                if (descriptor[h] >= 0) close(descriptor[h]);
+            }
+            return false;
+        }
+        io_uring_cqe cqe;
+        while (anillo.completada(cqe)) {
+            --enVuelo;
+            unsigned h = static_cast<unsigned>(cqe.user_data >> 2);
+            Fase fase = static_cast<Fase>(cqe.user_data & 3);
+            if (fase == CERRAR) continue;
+            if (cqe.res < 0) {
+                std::cerr << "Error al " << (fase == ABRIR ? "abrir" : "leer") << " el archivo de hechos: "
+                          << rutas[fichero[h]] << " (" << std::strerror(-cqe.res) << ")" << std::endl;
+                correcto = false;
+            } else if (fase == ABRIR) {
+                descriptor[h] = cqe.res;
+                io_uring_sqe* sqe = abortar ? nullptr : nuevaEntrada(h, LEER);
+                if (sqe) {
+                    sqe->opcode = fijos ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                    sqe->fd = descriptor[h];
+                    sqe->addr = reinterpret_cast<uint64_t>(buffers[h].iov_base);
+                    sqe->len = kHueco;
+                    sqe->buf_index = static_cast<uint16_t>(fijos ? h : 0);
+                    ++enVuelo;
+                    continue;
+                }
+                if (!abortar) {
+                    std::cerr << "Error: io_uring: no se pudo encolar la lectura de " << rutas[fichero[h]] << std::endl;
+                    correcto = false;
+                    abortar = true;
+                }
+            } else {
+                const char* datos = static_cast<const char*>(buffers[h].iov_base);
+                size_t tamano = static_cast<size_t>(cqe.res);
+                bool leido = true;
+                if (tamano == kHueco) {
+                    completo.assign(datos, tamano);
+                    char resto[16384];
+                    ssize_t leidos;
+                    while ((leidos = pread(descriptor[h], resto, sizeof(resto), static_cast<off_t>(completo.size()))) > 0) {
+                        completo.append(resto, static_cast<size_t>(leidos));
+                    }
+                    if (leidos < 0) {
+                        std::cerr << "Error al leer el archivo de hechos: " << rutas[fichero[h]] << " ("
+                                  << std::strerror(errno) << ")" << std::endl;
+                        correcto = leido = false;
+                    }
+                    datos = completo.data();
+                    tamano = completo.size();
+                }
+                if (leido && !entregar(fichero[h], datos, tamano)) correcto = false;
+            }
+            cerrarDescriptor(h);
+            libres.push_back(h);
+        }
+    }
+    return correcto;
+}
+#endif
+
+// Lee los ficheros con io_uring si el núcleo lo ofrece (y si no, uno tras otro) y entrega cada
+// uno en orden de llegada. Devuelve false si alguno no se pudo leer o entregar.
+bool leerFicherosMasivo(const std::vector<std::string>& rutas, unsigned profundidad, const EntregaFichero& entregar) {
+#ifdef SBR_IO_URING
+    if (!rutas.empty()) {
+        profundidad = std::max(1u, std::min(profundidad, 4096u));
+        AnilloIoUring anillo;
+        if (anillo.abrir(2 * profundidad)) return leerConIoUring(anillo, rutas, profundidad, entregar);
+        std::cerr << "Advertencia: io_uring no disponible (" << std::strerror(errno) << "); lectura secuencial." << std::endl;
+    }
+#else
+    (void)profundidad;
+#endif
+    return leerFicherosSecuencial(rutas, entregar);
+}
+
+// Carga un caso por fichero, en el orden de listarFicherosHechos
+bool cargarFicherosHechos(const std::string& ruta, unsigned profundidad, std::vector<BaseHechos>& casos) {
+    std::vector<std::string> rutas;
+    if (!listarFicherosHechos(ruta, rutas)) return false;
+    casos.assign(rutas.size(), BaseHechos());
+    return leerFicherosMasivo(rutas, profundidad, [&](size_t i, const char* datos, size_t tamano) {
+        if (cargarHechosDesdeBuffer(datos, tamano, casos[i])) return true;
+        std::cerr << "Error en el archivo de hechos " << rutas[i] << std::endl;
+        return false;
+    });
+}
+
+
 // --- Funciones de Impresión para Verificación (Opcional) ---
 void imprimirBaseConocimiento(const BaseConocimiento& bc) {
     std::cout << "--- Base de Conocimiento ---" << std::endl;
@@ -367,6 +1160,23 @@ void imprimirBaseConocimiento(const BaseConocimiento& bc) {
     std::cout << "---------------------------" << std::endl;
 }
 
+// Escribe la BC en el mismo formato que lee cargarReglas
+void escribirReglas(std::ostream& os, const BaseConocimiento& bc) {
+    std::streamsize precisionPrevia = os.precision(12);
+    os << bc.reglas.size() << '\n';
+    for (const auto& regla : bc.reglas) {
+        os << regla.id << ": Si ";
+        for (size_t i = 0; i < regla.antecedente.condiciones.size(); ++i) {
+            if (i > 0) os << (regla.antecedente.operador == OperadorLogico::O ? " o " : " y ");
+            os << regla.antecedente.condiciones[i].nombre;
+        }
+        os << " Entonces " << regla.consecuente.nombre << ", FC=" << regla.factorCertezaRegla;
+        if (regla.prioridad != 0) os << ", prioridad=" << regla.prioridad;
+        os << '\n';
+    }
+    os.precision(precisionPrevia);
+}
+
 void imprimirBaseHechos(const BaseHechos& bh) {
     std::cout << "--- Base de Hechos ---" << std::endl;
     std::cout << "Número de Hechos Iniciales: " << bh.hechos_iniciales.size() << std::endl;
@@ -382,46 +1192,6073 @@ void imprimirBaseHechos(const BaseHechos& bh) {
 }
 
 
-// --- Función Principal para Pruebas ---
-int main() {
-    BaseConocimiento bc;
-    BaseHechos bh;
+// --- Perfil de Ejecución ---
 
-    // Crear ficheros de prueba (esto es solo para que el ejemplo sea autocontenido)
-    // En un caso real, estos ficheros existirían previamente.
-    std::ofstream reglasFile("Prueba-1.reglas");
-    if (reglasFile.is_open()) {
-        reglasFile << "4\n";
-        reglasFile << "R1: Si h2 o h3 Entonces h1, FC = 0.5\n";
-        reglasFile << "R2: Si h4 Entonces h1, FC = 1\n";
-        reglasFile << "R3: Si h5 y h6 Entonces h3, FC = 0.7\n";
-        reglasFile << "R4: Si h7 Entonces h3, FC = -0.5\n";
-        reglasFile.close();
-    } else {
-        std::cerr << "No se pudo crear Prueba-1.reglas para el test." << std::endl;
-        return 1;
+// Contadores de una regla durante la inferencia. Los de condición van por su posición en el fichero.
+struct ContadoresRegla {
+    uint64_t evaluaciones = 0;   // Veces que se evaluó su antecedente
+    uint64_t cortocircuitos = 0; // Evaluaciones que terminaron antes de la última condición
+    uint64_t saturaciones = 0;   // Veces que su aportación saturó el consecuente
+    uint64_t disparos = 0;       // Evaluaciones con antecedente positivo
+    uint64_t noPositivas = 0;    // Evaluaciones cuya aportación fue nula o negativa
+    uint64_t ns = 0;             // Tiempo propio, sin contar las reglas anidadas
+    std::vector<uint64_t> evaluacionesCondicion;
+    std::vector<uint64_t> cortesCondicion; // Veces que la condición decidió el antecedente por sí sola
+};
+
+// Perfil de una BC, indexado por la posición de cada regla en el fichero
+struct PerfilReglas {
+    std::vector<ContadoresRegla> reglas;
+};
+
+void inicializarPerfil(const BaseConocimiento& bc, PerfilReglas& perfil) {
+    perfil.reglas.assign(bc.reglas.size(), ContadoresRegla());
+    for (size_t r = 0; r < bc.reglas.size(); ++r) {
+        size_t numCond = bc.reglas[r].antecedente.condiciones.size();
+        perfil.reglas[r].evaluacionesCondicion.assign(numCond, 0);
+        perfil.reglas[r].cortesCondicion.assign(numCond, 0);
     }
+}
 
-    std::ofstream hechosFile("Prueba-1.hechos");
-    if (hechosFile.is_open()) {
-        hechosFile << "5\n";
-        hechosFile << "h2, FC = 0.3\n";
-        hechosFile << "h4, FC = 0.6\n";
-        hechosFile << "h5, FC = 0.6\n";
-        hechosFile << "h6, FC = 0.9\n";
-        hechosFile << "h7, FC = 0.5\n";
-        hechosFile << "Objetivo\n";
-        hechosFile << "h1\n";
-        hechosFile.close();
-    } else {
-        std::cerr << "No se pudo crear Prueba-1.hechos para el test." << std::endl;
-        return 1;
+void acumularContadores(ContadoresRegla& destino, const ContadoresRegla& origen) {
+    destino.evaluaciones += origen.evaluaciones;
+    destino.cortocircuitos += origen.cortocircuitos;
+    destino.saturaciones += origen.saturaciones;
+    destino.disparos += origen.disparos;
+    destino.noPositivas += origen.noPositivas;
+    destino.ns += origen.ns;
+    for (size_t k = 0; k < origen.evaluacionesCondicion.size(); ++k) {
+        destino.evaluacionesCondicion[k] += origen.evaluacionesCondicion[k];
+        destino.cortesCondicion[k] += origen.cortesCondicion[k];
     }
+}
 
-    std::cout << "Cargando Base de Conocimiento desde Prueba-1.reglas..." << std::endl;
-    if (cargarReglas("Prueba-1.reglas", bc)) {
-        std::cout << "Base de Conocimiento cargada exitosamente." << std::endl;
-        imprimirBaseConocimiento(bc);
+// Formato: una línea por regla con campos separados por tabuladores
+//   id  evaluaciones  cortocircuitos  saturaciones  disparos  noPositivas  ns
+//   [evaluaciones corte] por condición
+bool guardarPerfil(const std::string& nombreArchivo, const BaseConocimiento& bc, const PerfilReglas& perfil) {
+    std::ofstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo de perfil: " << nombreArchivo << std::endl;
+        return false;
+    }
+    for (size_t r = 0; r < perfil.reglas.size(); ++r) {
+        const ContadoresRegla& c = perfil.reglas[r];
+        archivo << bc.reglas[r].id << '\t' << c.evaluaciones << '\t' << c.cortocircuitos << '\t' << c.saturaciones
+                << '\t' << c.disparos << '\t' << c.noPositivas << '\t' << c.ns;
+        for (size_t k = 0; k < c.evaluacionesCondicion.size(); ++k) {
+            archivo << '\t' << c.evaluacionesCondicion[k] << '\t' << c.cortesCondicion[k];
+        }
+        archivo << '\n';
+    }
+    return true;
+}
+
+// Carga un perfil y lo acumula sobre `perfil` (inicializado para la misma BC). Las reglas
+// se asocian por id; las que ya no existen o cambiaron de número de condiciones se ignoran.
+bool cargarPerfil(const std::string& nombreArchivo, const BaseConocimiento& bc, PerfilReglas& perfil) {
+    std::ifstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de perfil: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::unordered_map<std::string, size_t> posicion;
+    for (size_t r = 0; r < bc.reglas.size(); ++r) posicion[bc.reglas[r].id] = r;
+
+    std::string linea;
+    while (std::getline(archivo, linea)) {
+        std::istringstream campos(linea);
+        std::string id;
+        ContadoresRegla leidos;
+        if (!std::getline(campos, id, '\t') ||
+            !(campos >> leidos.evaluaciones >> leidos.cortocircuitos >> leidos.saturaciones
+                     >> leidos.disparos >> leidos.noPositivas >> leidos.ns)) {
+            continue;
+        }
+        uint64_t e, c;
+        while (campos >> e >> c) {
+            leidos.evaluacionesCondicion.push_back(e);
+            leidos.cortesCondicion.push_back(c);
+        }
+        auto it = posicion.find(id);
+        if (it == posicion.end()) continue;
+        ContadoresRegla& destino = perfil.reglas[it->second];
+        if (leidos.evaluacionesCondicion.size() != destino.evaluacionesCondicion.size()) continue;
+        acumularContadores(destino, leidos);
+    }
+    return true;
+}
+
+
+// --- Compilación de la Base de Conocimiento ---
+
+// Orden en que se numeran símbolos y reglas al compilar
+enum class OrdenCompilacion {
+    ARCHIVO,   // Orden de aparición en el fichero de reglas
+    LOCALIDAD  // Recorrido en anchura del grafo reglas/hechos desde los objetivos raíz
+};
+
+// Base de Conocimiento compilada: símbolos internados y reglas en arrays contiguos.
+// Las listas de condiciones y de reglas por símbolo se guardan en formato CSR
+// (un vector de inicios y un vector plano de elementos).
+struct BaseCompilada {
+    std::vector<std::string> simbolos;              // id -> nombre
+    std::unordered_map<std::string, int> idSimbolo; // nombre -> id
+
+    // Reglas, indexadas por id compilado
+    std::vector<int> origenRegla;     // Índice en BaseConocimiento::reglas (orden del fichero)
+    std::vector<OperadorLogico> operadorRegla;
+    std::vector<int> consecuenteRegla;
+    std::vector<double> fcRegla;
+    std::vector<int> prioridadRegla;
+    std::vector<int> inicioCondiciones; // Condiciones de r en [inicioCondiciones[r], inicioCondiciones[r+1])
+    std::vector<int> condiciones;       // Ids de símbolo
+    std::vector<int> origenCondicion;   // Posición de cada condición en el antecedente del fichero
+
+    // Reglas que concluyen cada símbolo, en orden de evaluación
+    std::vector<int> inicioReglasDe;
+    std::vector<int> reglasDe;
+
+    // Por símbolo: bit 1 si una contribución de +1 cierra la evaluación, bit 2 si la cierra una de -1.
+    // Sólo es válido cortar cuando ninguna regla del símbolo puede aportar el valor opuesto.
+    std::vector<uint8_t> saturable;
+
+    // Literales de comparación: atributo de cada símbolo (-1 si no es una comparación) y, por
+    // atributo y operador, los literales ordenados por umbral. Un valor nuevo del atributo
+    // encuentra los literales que cumple con una búsqueda binaria por operador.
+    std::vector<std::string> atributos;
+    std::unordered_map<std::string, int> idAtributo;
+    std::vector<int> atributoDe;
+    std::vector<int> inicioUmbrales;              // Grupo a*5+op en [inicioUmbrales[g], inicioUmbrales[g+1])
+    std::vector<std::pair<double, int>> umbrales; // (umbral, símbolo)
+};
+
+int buscarSimbolo(const BaseCompilada& bcc, const std::string& nombre) {
+    auto it = bcc.idSimbolo.find(nombre);
+    return it == bcc.idSimbolo.end() ? -1 : it->second;
+}
+
+// Calcula el orden de localidad: BFS sobre el grafo bipartito reglas/hechos partiendo de los
+// símbolos que no aparecen en ningún antecedente (objetivos raíz). Desde un símbolo se visitan
+// las reglas que lo concluyen y desde una regla sus condiciones, de modo que el cono de
+// dependencias de cada objetivo queda numerado de forma consecutiva.
+// Devuelve el nuevo orden de símbolos (por nombre) y de reglas (por índice de fichero).
+static void ordenarPorLocalidad(const BaseConocimiento& bc,
+                                const std::vector<std::string>& simbolosArchivo,
+                                const std::unordered_map<std::string, int>& idArchivo,
+                                std::vector<int>& ordenSimbolos, std::vector<int>& ordenReglas) {
+    size_t n = simbolosArchivo.size();
+    std::vector<std::vector<int>> reglasQueConcluyen(n);
+    std::vector<bool> esCondicion(n, false);
+    for (size_t r = 0; r < bc.reglas.size(); ++r) {
+        reglasQueConcluyen[idArchivo.at(bc.reglas[r].consecuente.nombre)].push_back(static_cast<int>(r));
+        for (const auto& c : bc.reglas[r].antecedente.condiciones) {
+            esCondicion[idArchivo.at(c.nombre)] = true;
+        }
+    }
+
+    std::vector<bool> simboloVisitado(n, false);
+    std::vector<bool> reglaVisitada(bc.reglas.size(), false);
+    std::vector<int> cola;
+    auto recorrer = [&](int raiz) {
+        if (simboloVisitado[raiz]) return;
+        simboloVisitado[raiz] = true;
+        cola.assign(1, raiz);
+        for (size_t i = 0; i < cola.size(); ++i) {
+            int s = cola[i];
+            ordenSimbolos.push_back(s);
+            for (int r : reglasQueConcluyen[s]) {
+                if (reglaVisitada[r]) continue;
+                reglaVisitada[r] = true;
+                ordenReglas.push_back(r);
+                for (const auto& c : bc.reglas[r].antecedente.condiciones) {
+                    int sc = idArchivo.at(c.nombre);
+                    if (!simboloVisitado[sc]) {
+                        simboloVisitado[sc] = true;
+                        cola.push_back(sc);
+                    }
+                }
+            }
+        }
+    };
+    for (size_t s = 0; s < n; ++s) {
+        if (!esCondicion[s]) recorrer(static_cast<int>(s));
+    }
+    // Los ciclos sin raíz quedan al final, en orden de fichero
+    for (size_t s = 0; s < n; ++s) recorrer(static_cast<int>(s));
+}
+
+// Con un perfil, además del orden elegido:
+//  - las reglas más evaluadas se colocan juntas al principio de los arrays,
+//  - las reglas de cada símbolo se evalúan primero si suelen saturarlo,
+//  - las condiciones de cada regla se evalúan primero si suelen decidir el antecedente.
+BaseCompilada compilarBase(const BaseConocimiento& bc, OrdenCompilacion orden = OrdenCompilacion::LOCALIDAD,
+                           const PerfilReglas* perfil = nullptr) {
+    // 1. Internar símbolos en orden de aparición
+    std::vector<std::string> simbolosArchivo;
+    std::unordered_map<std::string, int> idArchivo;
+    auto internar = [&](const std::string& nombre) {
+        if (idArchivo.emplace(nombre, static_cast<int>(simbolosArchivo.size())).second) {
+            simbolosArchivo.push_back(nombre);
+        }
+    };
+    for (const auto& regla : bc.reglas) {
+        internar(regla.consecuente.nombre);
+        for (const auto& c : regla.antecedente.condiciones) internar(c.nombre);
+    }
+
+    // 2. Decidir la numeración final
+    std::vector<int> ordenSimbolos, ordenReglas;
+    if (orden == OrdenCompilacion::LOCALIDAD) {
+        ordenarPorLocalidad(bc, simbolosArchivo, idArchivo, ordenSimbolos, ordenReglas);
+    } else {
+        for (size_t s = 0; s < simbolosArchivo.size(); ++s) ordenSimbolos.push_back(static_cast<int>(s));
+        for (size_t r = 0; r < bc.reglas.size(); ++r) ordenReglas.push_back(static_cast<int>(r));
+    }
+
+    if (perfil) {
+        std::stable_sort(ordenReglas.begin(), ordenReglas.end(), [&](int a, int b) {
+            return perfil->reglas[a].evaluaciones > perfil->reglas[b].evaluaciones;
+        });
+    }
+
+    BaseCompilada bcc;
+    std::vector<int> nuevoId(simbolosArchivo.size());
+    for (size_t i = 0; i < ordenSimbolos.size(); ++i) {
+        nuevoId[ordenSimbolos[i]] = static_cast<int>(i);
+        bcc.simbolos.push_back(simbolosArchivo[ordenSimbolos[i]]);
+        bcc.idSimbolo[bcc.simbolos.back()] = static_cast<int>(i);
+    }
+
+    // 3. Volcar las reglas en los arrays contiguos
+    size_t numSimbolos = bcc.simbolos.size();
+    std::vector<int> reglasPorSimbolo(numSimbolos + 1, 0);
+    bcc.saturable.assign(numSimbolos, 3);
+    bcc.inicioCondiciones.push_back(0);
+    for (int r : ordenReglas) {
+        const Regla& regla = bc.reglas[r];
+        int consecuente = nuevoId[idArchivo.at(regla.consecuente.nombre)];
+        bcc.origenRegla.push_back(r);
+        bcc.operadorRegla.push_back(regla.antecedente.operador);
+        bcc.consecuenteRegla.push_back(consecuente);
+        bcc.fcRegla.push_back(regla.factorCertezaRegla);
+        bcc.prioridadRegla.push_back(regla.prioridad);
+        std::vector<int> ordenCond(regla.antecedente.condiciones.size());
+        for (size_t k = 0; k < ordenCond.size(); ++k) ordenCond[k] = static_cast<int>(k);
+        if (perfil) {
+            const ContadoresRegla& cont = perfil->reglas[r];
+            auto tasaCorte = [&](int k) {
+                return cont.evaluacionesCondicion[k] == 0 ? 0.0
+                     : static_cast<double>(cont.cortesCondicion[k]) / cont.evaluacionesCondicion[k];
+            };
+            std::stable_sort(ordenCond.begin(), ordenCond.end(),
+                             [&](int a, int b) { return tasaCorte(a) > tasaCorte(b); });
+        }
+        for (int k : ordenCond) {
+            bcc.condiciones.push_back(nuevoId[idArchivo.at(regla.antecedente.condiciones[k].nombre)]);
+            bcc.origenCondicion.push_back(k);
+        }
+        bcc.inicioCondiciones.push_back(static_cast<int>(bcc.condiciones.size()));
+        reglasPorSimbolo[consecuente + 1]++;
+        if (regla.factorCertezaRegla <= -1.0) bcc.saturable[consecuente] &= ~1;
+        if (regla.factorCertezaRegla >= 1.0) bcc.saturable[consecuente] &= ~2;
+    }
+
+    for (size_t s = 0; s < numSimbolos; ++s) reglasPorSimbolo[s + 1] += reglasPorSimbolo[s];
+    bcc.inicioReglasDe = reglasPorSimbolo;
+    bcc.reglasDe.resize(bcc.origenRegla.size());
+    std::vector<int> siguiente(reglasPorSimbolo.begin(), reglasPorSimbolo.end() - 1);
+    for (size_t r = 0; r < bcc.origenRegla.size(); ++r) {
+        bcc.reglasDe[siguiente[bcc.consecuenteRegla[r]]++] = static_cast<int>(r);
+    }
+    if (perfil) {
+        for (size_t s = 0; s < numSimbolos; ++s) {
+            std::stable_sort(bcc.reglasDe.begin() + bcc.inicioReglasDe[s], bcc.reglasDe.begin() + bcc.inicioReglasDe[s + 1],
+                             [&](int a, int b) {
+                                 return perfil->reglas[bcc.origenRegla[a]].saturaciones >
+                                        perfil->reglas[bcc.origenRegla[b]].saturaciones;
+                             });
+        }
+    }
+
+    // 4. Índice de umbrales de los literales de comparación
+    const int kOperadores = 5;
+    bcc.atributoDe.assign(numSimbolos, -1);
+    std::vector<std::pair<int, std::pair<double, int>>> porGrupo; // (grupo, (umbral, símbolo))
+    for (size_t s = 0; s < numSimbolos; ++s) {
+        Comparacion comp;
+        if (!parsearComparacion(bcc.simbolos[s], comp)) continue;
+        auto it = bcc.idAtributo.emplace(comp.atributo, static_cast<int>(bcc.atributos.size())).first;
+        if (it->second == static_cast<int>(bcc.atributos.size())) bcc.atributos.push_back(comp.atributo);
+        bcc.atributoDe[s] = it->second;
+        porGrupo.push_back({it->second * kOperadores + static_cast<int>(comp.operador), {comp.umbral, static_cast<int>(s)}});
+    }
+    std::sort(porGrupo.begin(), porGrupo.end());
+    bcc.inicioUmbrales.assign(bcc.atributos.size() * kOperadores + 1, 0);
+    for (const auto& g : porGrupo) {
+        bcc.inicioUmbrales[g.first + 1]++;
+        bcc.umbrales.push_back(g.second);
+    }
+    for (size_t g = 1; g < bcc.inicioUmbrales.size(); ++g) bcc.inicioUmbrales[g] += bcc.inicioUmbrales[g - 1];
+    return bcc;
+}
+
+// Añade a `cumplidos` los literales del atributo que se cumplen con `valor`. Cada operador
+// es un rango contiguo de su lista ordenada: O(log n + k) en total.
+void literalesCumplidos(const BaseCompilada& bcc, int atributo, double valor, std::vector<int>& cumplidos) {
+    auto grupo = [&](OperadorComparacion op) {
+        int g = atributo * 5 + static_cast<int>(op);
+        return std::make_pair(bcc.umbrales.begin() + bcc.inicioUmbrales[g], bcc.umbrales.begin() + bcc.inicioUmbrales[g + 1]);
+    };
+    auto anadir = [&](std::vector<std::pair<double, int>>::const_iterator desde,
+                      std::vector<std::pair<double, int>>::const_iterator hasta) {
+        for (auto it = desde; it < hasta; ++it) cumplidos.push_back(it->second);
+    };
+    auto menorUmbral = [](const std::pair<double, int>& u, double v) { return u.first < v; };
+    auto mayorUmbral = [](double v, const std::pair<double, int>& u) { return v < u.first; };
+    auto g = grupo(OperadorComparacion::MAYOR);       // umbral < valor
+    anadir(g.first, std::lower_bound(g.first, g.second, valor, menorUmbral));
+    g = grupo(OperadorComparacion::MAYOR_IGUAL);      // umbral <= valor
+    anadir(g.first, std::upper_bound(g.first, g.second, valor, mayorUmbral));
+    g = grupo(OperadorComparacion::MENOR);            // umbral > valor
+    anadir(std::upper_bound(g.first, g.second, valor, mayorUmbral), g.second);
+    g = grupo(OperadorComparacion::MENOR_IGUAL);      // umbral >= valor
+    anadir(std::lower_bound(g.first, g.second, valor, menorUmbral), g.second);
+    g = grupo(OperadorComparacion::IGUAL);
+    anadir(std::lower_bound(g.first, g.second, valor, menorUmbral), std::upper_bound(g.first, g.second, valor, mayorUmbral));
+}
+
+// --- Cálculos de Incertidumbre ---
+
+// Combinación de dos FC sobre el mismo hecho (Caso 2). Un valor de ±1 es absorbente, lo que
+// también resuelve la contradicción +1/-1 a favor del primero en orden de fichero.
+constexpr double combinarFc(double a, double b) {
+    return a >= 1.0 || a <= -1.0 ? a
+         : a >= 0 && b >= 0 ? a + b * (1 - a)
+         : a <= 0 && b <= 0 ? a + b * (1 + a)
+         : (a + b) / (1 - std::min(a < 0 ? -a : a, b < 0 ? -b : b));
+}
+
+// Políticas con las que se instancia el motor: conjunción (y), disyunción (o), encadenamiento
+// de la regla con su antecedente y combinación de aportaciones al mismo hecho. Son funciones
+// constexpr sin estado, así que elegir el cálculo no cuesta nada por operación y los bucles
+// por carril de la evaluación por bloques se pueden vectorizar.
+// Todas comparten las condiciones que usa el motor para cortar: un valor <= 0 anula la
+// conjunción, uno >= 1 decide la disyunción, sólo dispara un antecedente > 0, y una
+// aportación >= 1 es absorbente al combinar. Salvo MYCIN, esperan grados en [0, 1].
+struct CalculoMycin {
+    static constexpr const char* nombre = "mycin";
+    static constexpr double minimo = -1.0; // Grado más bajo posible
+    static constexpr double y(double a, double b) { return std::min(a, b); }
+    static constexpr double o(double a, double b) { return std::max(a, b); }
+    static constexpr double encadenar(double fcRegla, double antecedente) { return fcRegla * antecedente; }
+    static constexpr double combinar(double a, double b) { return combinarFc(a, b); }
+    static constexpr bool satura(double aportacion, uint8_t saturable) {
+        return (aportacion >= 1.0 && (saturable & 1)) || (aportacion <= -1.0 && (saturable & 2));
+    }
+};
+
+// Lógica difusa de Zadeh: mínimo y máximo; la regla recorta su antecedente (Mamdani)
+struct CalculoDifuso {
+    static constexpr const char* nombre = "difuso";
+    static constexpr double minimo = 0.0;
+    static constexpr double y(double a, double b) { return std::min(a, b); }
+    static constexpr double o(double a, double b) { return std::max(a, b); }
+    static constexpr double encadenar(double fcRegla, double antecedente) { return std::min(fcRegla, antecedente); }
+    static constexpr double combinar(double a, double b) { return std::max(a, b); }
+    static constexpr bool satura(double aportacion, uint8_t) { return aportacion >= 1.0; }
+};
+
+// Producto y suma probabilística (eventos independientes)
+struct CalculoProbabilistico {
+    static constexpr const char* nombre = "probabilistico";
+    static constexpr double minimo = 0.0;
+    static constexpr double y(double a, double b) { return std::min(a, b) <= 0.0 ? std::min(a, b) : a * b; }
+    static constexpr double o(double a, double b) { return a >= 1.0 ? a : b >= 1.0 ? b : a + b - a * b; }
+    static constexpr double encadenar(double fcRegla, double antecedente) { return fcRegla * antecedente; }
+    static constexpr double combinar(double a, double b) { return a >= 1.0 ? a : b >= 1.0 ? b : a + b - a * b; }
+    static constexpr bool satura(double aportacion, uint8_t) { return aportacion >= 1.0; }
+};
+
+// Lógica de Łukasiewicz: t-norma y t-conorma acotadas; la regla es la t-norma de su peso y su antecedente
+struct CalculoLukasiewicz {
+    static constexpr const char* nombre = "lukasiewicz";
+    static constexpr double minimo = 0.0;
+    static constexpr double y(double a, double b) { return std::max(0.0, a + b - 1.0); }
+    static constexpr double o(double a, double b) { return a >= 1.0 ? a : b >= 1.0 ? b : std::min(1.0, a + b); }
+    static constexpr double encadenar(double fcRegla, double antecedente) { return std::max(0.0, fcRegla + antecedente - 1.0); }
+    static constexpr double combinar(double a, double b) { return a >= 1.0 ? a : b >= 1.0 ? b : std::min(1.0, a + b); }
+    static constexpr bool satura(double aportacion, uint8_t) { return aportacion >= 1.0; }
+};
+
+static_assert(CalculoMycin::combinar(0.5, 0.5) == 0.75, "MYCIN: 0.5 + 0.5 * (1 - 0.5)");
+static_assert(CalculoProbabilistico::o(0.5, 0.5) == 0.75, "Suma probabilística");
+static_assert(CalculoLukasiewicz::y(0.75, 0.5) == 0.25, "T-norma de Łukasiewicz");
+
+enum class TipoCalculo { MYCIN, DIFUSO, PROBABILISTICO, LUKASIEWICZ };
+
+bool parsearCalculo(const std::string& texto, TipoCalculo& calculo) {
+    std::string t = toLower(texto);
+    if (t == CalculoMycin::nombre) calculo = TipoCalculo::MYCIN;
+    else if (t == CalculoDifuso::nombre) calculo = TipoCalculo::DIFUSO;
+    else if (t == CalculoProbabilistico::nombre) calculo = TipoCalculo::PROBABILISTICO;
+    else if (t == CalculoLukasiewicz::nombre) calculo = TipoCalculo::LUKASIEWICZ;
+    else return false;
+    return true;
+}
+
+const char* nombreCalculo(TipoCalculo calculo) {
+    switch (calculo) {
+        case TipoCalculo::MYCIN: return CalculoMycin::nombre;
+        case TipoCalculo::DIFUSO: return CalculoDifuso::nombre;
+        case TipoCalculo::PROBABILISTICO: return CalculoProbabilistico::nombre;
+        case TipoCalculo::LUKASIEWICZ: return CalculoLukasiewicz::nombre;
+    }
+    return "?";
+}
+
+
+// --- Motor de Inferencia (encadenamiento hacia atrás) ---
+
+enum class EstadoSimbolo : uint8_t {
+    DESCONOCIDO,
+    EN_CURSO,  // En la pila de evaluación (ciclo en la BC)
+    CONOCIDO
+};
+
+// Cómo se resolvió un símbolo durante una consulta explicada
+enum class ResultadoMemo : uint8_t {
+    FALLO,   // Calculado con sus reglas
+    ACIERTO, // Ya calculado en esta consulta
+    HECHO,   // Hecho inicial de la BH
+    CICLO    // En la pila de evaluación
+};
+
+// Nodo del árbol de subobjetivos de una consulta explicada (EXPLAIN ANALYZE)
+struct NodoExplicacion {
+    int simbolo = -1;
+    int profundidad = 0;
+    ResultadoMemo memo = ResultadoMemo::FALLO;
+    double fc = 0.0;
+    int64_t ns = 0;              // Tiempo inclusivo (al abrir el nodo guarda el instante de inicio)
+    int reglasConsideradas = 0;  // Reglas cuyo antecedente se evaluó
+    int reglasDisparadas = 0;    // Reglas con antecedente positivo
+    int reglasPodadas = 0;       // Reglas omitidas por saturación
+    int condicionesPodadas = 0;  // Condiciones omitidas por cortocircuito
+    std::vector<int> hijos;
+};
+
+struct ExplicacionConsulta {
+    std::vector<NodoExplicacion> nodos; // nodos[0] es el objetivo
+    std::vector<int> pila;
+};
+
+// Memoria de trabajo del motor sobre una BaseCompilada. Se reutiliza entre consultas:
+// un valor sólo es válido si su época coincide con la actual, así que empezar una consulta
+// nueva no recorre todos los símbolos. Los hechos iniciales llevan su propia época para
+// poder lanzar varias consultas sobre la misma BH sin volver a cargarlos.
+struct EstadoInferencia {
+    std::vector<double> fc;
+    std::vector<EstadoSimbolo> estado;
+    std::vector<uint32_t> epoca;
+    uint32_t epocaActual = 0;
+    std::vector<double> fcHecho;
+    std::vector<uint32_t> epocaHecho;
+    uint32_t epocaHechosActual = 0;
+    std::vector<double> fcAtributo;     // FC del hecho numérico de cada atributo conocido
+    std::vector<uint32_t> epocaAtributo; // Con la época de los hechos
+    std::vector<int> cumplidos;          // Auxiliar de prepararEstado
+    std::vector<std::pair<int, double>> contribuciones; // Pila (origen de la regla, FC aportado)
+    PerfilReglas* perfil = nullptr; // Si no es nulo, se registran los contadores de cada regla
+    uint64_t nsAnidado = 0;         // Con perfil: tiempo de las reglas ya medidas dentro de la actual
+    ExplicacionConsulta* explicacion = nullptr; // Si no es nulo, se registra el árbol de subobjetivos
+};
+
+// Empieza una consulta nueva olvidando lo inferido, pero no los hechos iniciales
+void nuevaConsulta(EstadoInferencia& est) {
+    if (++est.epocaActual == 0) { // Desbordamiento de la época: invalidar todo explícitamente
+        std::fill(est.epoca.begin(), est.epoca.end(), 0);
+        est.epocaActual = 1;
+    }
+    est.contribuciones.clear();
+}
+
+// Carga los hechos iniciales de la BH en el estado y empieza una consulta nueva
+// Dimensiona el estado para la BC si hace falta y abre una época de hechos vacía
+static void vaciarHechos(const BaseCompilada& bcc, EstadoInferencia& est) {
+    size_t n = bcc.simbolos.size();
+    if (est.fc.size() != n || est.fcAtributo.size() != bcc.atributos.size()) {
+        est.fc.assign(n, 0.0);
+        est.estado.assign(n, EstadoSimbolo::DESCONOCIDO);
+        est.epoca.assign(n, 0);
+        est.epocaActual = 0;
+        est.fcHecho.assign(n, 0.0);
+        est.epocaHecho.assign(n, 0);
+        est.epocaHechosActual = 0;
+        est.fcAtributo.assign(bcc.atributos.size(), 0.0);
+        est.epocaAtributo.assign(bcc.atributos.size(), 0);
+    }
+    if (++est.epocaHechosActual == 0) {
+        std::fill(est.epocaHecho.begin(), est.epocaHecho.end(), 0);
+        std::fill(est.epocaAtributo.begin(), est.epocaAtributo.end(), 0);
+        est.epocaHechosActual = 1;
+    }
+}
+
+void prepararEstado(const BaseCompilada& bcc, const BaseHechos& bh, EstadoInferencia& est) {
+    vaciarHechos(bcc, est);
+    for (const auto& par : bh.fc_memoria) {
+        int s = buscarSimbolo(bcc, par.first);
+        if (s < 0) continue;
+        est.fcHecho[s] = par.second;
+        est.epocaHecho[s] = est.epocaHechosActual;
+    }
+    // Hechos numéricos: se activan (FC) sólo los literales que se cumplen; los demás del
+    // atributo se resuelven como falsos (-FC) al evaluarlos. Un literal dado explícitamente
+    // como hecho en la BH conserva su FC.
+    for (const auto& par : bh.valores) {
+        auto it = bcc.idAtributo.find(par.first);
+        if (it == bcc.idAtributo.end()) continue;
+        est.fcAtributo[it->second] = par.second.factorCerteza;
+        est.epocaAtributo[it->second] = est.epocaHechosActual;
+        est.cumplidos.clear();
+        literalesCumplidos(bcc, it->second, par.second.valor, est.cumplidos);
+        for (int s : est.cumplidos) {
+            if (est.epocaHecho[s] == est.epocaHechosActual) continue; // Sólo puede venir de fc_memoria
+            est.fcHecho[s] = par.second.factorCerteza;
+            est.epocaHecho[s] = est.epocaHechosActual;
+        }
+    }
+    nuevaConsulta(est);
+}
+
+// Como prepararEstado, con los hechos dados por id de símbolo (una fila de una matriz de
+// casos). Un id negativo o un FC NaN es una columna sin hecho en este caso.
+void prepararEstadoFila(const BaseCompilada& bcc, const int* simbolos, const double* fcs, size_t n, EstadoInferencia& est) {
+    vaciarHechos(bcc, est);
+    for (size_t j = 0; j < n; ++j) {
+        if (simbolos[j] < 0 || std::isnan(fcs[j])) continue;
+        est.fcHecho[simbolos[j]] = fcs[j];
+        est.epocaHecho[simbolos[j]] = est.epocaHechosActual;
+    }
+    nuevaConsulta(est);
+}
+
+static int64_t relojNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int abrirNodo(ExplicacionConsulta& ex, int s) {
+    int nodo = static_cast<int>(ex.nodos.size());
+    ex.nodos.emplace_back();
+    ex.nodos[nodo].simbolo = s;
+    ex.nodos[nodo].profundidad = static_cast<int>(ex.pila.size());
+    if (!ex.pila.empty()) ex.nodos[ex.pila.back()].hijos.push_back(nodo);
+    ex.pila.push_back(nodo);
+    ex.nodos[nodo].ns = relojNs();
+    return nodo;
+}
+
+static double cerrarNodo(ExplicacionConsulta& ex, int nodo, ResultadoMemo memo, double fc) {
+    ex.nodos[nodo].ns = relojNs() - ex.nodos[nodo].ns;
+    ex.nodos[nodo].memo = memo;
+    ex.nodos[nodo].fc = fc;
+    ex.pila.pop_back();
+    return fc;
+}
+
+template <typename Calculo = CalculoMycin>
+double evaluarSimbolo(const BaseCompilada& bcc, EstadoInferencia& est, int s) {
+    ExplicacionConsulta* ex = est.explicacion;
+    int nodo = ex ? abrirNodo(*ex, s) : -1;
+    if (est.epoca[s] == est.epocaActual) {
+        // Conocido, o ciclo: un hecho que depende de sí mismo no aporta evidencia
+        bool conocido = est.estado[s] == EstadoSimbolo::CONOCIDO;
+        double valor = conocido ? est.fc[s] : 0.0;
+        return ex ? cerrarNodo(*ex, nodo, conocido ? ResultadoMemo::ACIERTO : ResultadoMemo::CICLO, valor) : valor;
+    }
+    est.epoca[s] = est.epocaActual;
+    if (est.epocaHecho[s] == est.epocaHechosActual) {
+        // Hecho inicial: su FC es el de la BH aunque haya reglas que lo concluyan
+        est.fc[s] = est.fcHecho[s];
+        est.estado[s] = EstadoSimbolo::CONOCIDO;
+        return ex ? cerrarNodo(*ex, nodo, ResultadoMemo::HECHO, est.fc[s]) : est.fc[s];
+    }
+    int atributo = bcc.atributoDe[s];
+    if (atributo >= 0 && est.epocaAtributo[atributo] == est.epocaHechosActual) {
+        // Comparación sobre un atributo conocido que no se activó al cargar los hechos: falsa
+        est.fc[s] = -est.fcAtributo[atributo];
+        est.estado[s] = EstadoSimbolo::CONOCIDO;
+        return ex ? cerrarNodo(*ex, nodo, ResultadoMemo::HECHO, est.fc[s]) : est.fc[s];
+    }
+    est.estado[s] = EstadoSimbolo::EN_CURSO;
+    SBR_SONDA1(memo_fallo, s);
+
+    size_t base = est.contribuciones.size();
+    for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1]; ++k) {
+        int r = bcc.reglasDe[k];
+        int inicio = bcc.inicioCondiciones[r], fin = bcc.inicioCondiciones[r + 1];
+
+        ContadoresRegla* contadores = est.perfil ? &est.perfil->reglas[bcc.origenRegla[r]] : nullptr;
+        int64_t t0 = 0;
+        uint64_t nsAnidadoPrevio = 0;
+        if (contadores) {
+            contadores->evaluaciones++;
+            nsAnidadoPrevio = est.nsAnidado;
+            est.nsAnidado = 0;
+            t0 = relojNs();
+        }
+        if (ex) ex->nodos[nodo].reglasConsideradas++;
+
+        // Caso 1: combinación de antecedentes (y = mínimo, o = máximo), con cortocircuito
+        // cuando el resultado ya no puede cambiar la aportación de la regla
+        bool esO = bcc.operadorRegla[r] == OperadorLogico::O;
+        double antecedente = 0.0;
+        int c = inicio;
+        while (c < fin) {
+            double valor = evaluarSimbolo<Calculo>(bcc, est, bcc.condiciones[c]);
+            antecedente = c == inicio ? valor : (esO ? Calculo::o(antecedente, valor) : Calculo::y(antecedente, valor));
+            bool decide = esO ? valor >= 1.0 : valor <= 0.0;
+            if (contadores) {
+                contadores->evaluacionesCondicion[bcc.origenCondicion[c]]++;
+                if (decide) contadores->cortesCondicion[bcc.origenCondicion[c]]++;
+            }
+            ++c;
+            if (decide) break;
+        }
+        if (contadores && c < fin) contadores->cortocircuitos++;
+        if (ex) ex->nodos[nodo].condicionesPodadas += fin - c;
+
+        // Caso 3: encadenamiento (sin aportación si el antecedente no es positivo)
+        double aportacion = antecedente > 0.0 ? Calculo::encadenar(bcc.fcRegla[r], antecedente) : 0.0;
+        if (contadores) {
+            // Tiempo propio: el de la regla menos el de las reglas evaluadas dentro
+            uint64_t total = static_cast<uint64_t>(relojNs() - t0);
+            contadores->ns += total - std::min(total, est.nsAnidado);
+            est.nsAnidado = nsAnidadoPrevio + total;
+            if (antecedente > 0.0) contadores->disparos++;
+            if (aportacion <= 0.0) contadores->noPositivas++;
+        }
+        if (antecedente <= 0.0) continue; // La regla no se activa
+        if (ex) ex->nodos[nodo].reglasDisparadas++;
+        SBR_SONDA2(regla_disparo, bcc.origenRegla[r], s);
+        est.contribuciones.emplace_back(bcc.origenRegla[r], aportacion);
+        if (Calculo::satura(aportacion, bcc.saturable[s])) {
+            if (contadores) contadores->saturaciones++;
+            if (ex) ex->nodos[nodo].reglasPodadas = bcc.inicioReglasDe[s + 1] - k - 1;
+            break; // Saturado: el resto de reglas no puede cambiar el resultado
+        }
+    }
+
+    // Caso 2: las aportaciones se combinan siempre en orden de fichero, porque la
+    // combinación de signos mixtos no es asociativa y el orden compilado puede diferir
+    auto inicio = est.contribuciones.begin() + base;
+    std::sort(inicio, est.contribuciones.end());
+    double resultado = 0.0;
+    bool primera = true;
+    for (auto it = inicio; it != est.contribuciones.end(); ++it) {
+        resultado = primera ? it->second : Calculo::combinar(resultado, it->second);
+        primera = false;
+    }
+    est.contribuciones.resize(base);
+
+    est.fc[s] = resultado;
+    est.estado[s] = EstadoSimbolo::CONOCIDO;
+    return ex ? cerrarNodo(*ex, nodo, ResultadoMemo::FALLO, resultado) : resultado;
+}
+
+// Calcula el FC del objetivo de la BH y lo guarda en bh.objetivo y en la memoria de trabajo
+template <typename Calculo = CalculoMycin>
+double motorDeInferencia(const BaseCompilada& bcc, BaseHechos& bh, EstadoInferencia& est) {
+    int objetivo = buscarSimbolo(bcc, bh.objetivo.nombre);
+    double resultado;
+    if (objetivo < 0) {
+        // El objetivo no aparece en la BC: sólo puede conocerse como hecho inicial
+        auto it = bh.fc_memoria.find(bh.objetivo.nombre);
+        resultado = it == bh.fc_memoria.end() ? 0.0 : it->second;
+    } else {
+        SBR_SONDA1(consulta_inicio, bh.objetivo.nombre.c_str());
+        prepararEstado(bcc, bh, est);
+        resultado = evaluarSimbolo<Calculo>(bcc, est, objetivo);
+        SBR_SONDA2(consulta_fin, bh.objetivo.nombre.c_str(), static_cast<long>(resultado * 1e6));
+    }
+    bh.objetivo.factorCerteza = resultado;
+    bh.fc_memoria[bh.objetivo.nombre] = resultado;
+    return resultado;
+}
+
+// Elige la instancia del motor una vez por consulta, no por operación
+double motorDeInferencia(TipoCalculo calculo, const BaseCompilada& bcc, BaseHechos& bh, EstadoInferencia& est) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: return motorDeInferencia<CalculoDifuso>(bcc, bh, est);
+        case TipoCalculo::PROBABILISTICO: return motorDeInferencia<CalculoProbabilistico>(bcc, bh, est);
+        case TipoCalculo::LUKASIEWICZ: return motorDeInferencia<CalculoLukasiewicz>(bcc, bh, est);
+        case TipoCalculo::MYCIN: break;
+    }
+    return motorDeInferencia<CalculoMycin>(bcc, bh, est);
+}
+
+// Varios objetivos sobre la misma BH: los hechos se cargan una vez y lo inferido para un
+// objetivo sirve a los siguientes. fc recibe un FC por objetivo.
+template <typename Calculo = CalculoMycin>
+void inferirObjetivos(const BaseCompilada& bcc, const BaseHechos& bh, EstadoInferencia& est,
+                      const std::vector<std::string>& objetivos, double* fc) {
+    prepararEstado(bcc, bh, est);
+    for (size_t k = 0; k < objetivos.size(); ++k) {
+        int s = buscarSimbolo(bcc, objetivos[k]);
+        if (s >= 0) {
+            fc[k] = evaluarSimbolo<Calculo>(bcc, est, s);
+        } else {
+            auto it = bh.fc_memoria.find(objetivos[k]); // Fuera de la BC sólo puede ser un hecho inicial
+            fc[k] = it == bh.fc_memoria.end() ? 0.0 : it->second;
+        }
+    }
+}
+
+void inferirObjetivos(TipoCalculo calculo, const BaseCompilada& bcc, const BaseHechos& bh, EstadoInferencia& est,
+                      const std::vector<std::string>& objetivos, double* fc) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: return inferirObjetivos<CalculoDifuso>(bcc, bh, est, objetivos, fc);
+        case TipoCalculo::PROBABILISTICO: return inferirObjetivos<CalculoProbabilistico>(bcc, bh, est, objetivos, fc);
+        case TipoCalculo::LUKASIEWICZ: return inferirObjetivos<CalculoLukasiewicz>(bcc, bh, est, objetivos, fc);
+        case TipoCalculo::MYCIN: break;
+    }
+    inferirObjetivos<CalculoMycin>(bcc, bh, est, objetivos, fc);
+}
+
+// --- Encadenamiento hacia Delante ---
+
+// Estrategias de resolución de conflictos: qué regla de la agenda se dispara primero.
+// PRIORIDAD usa la saliencia del fichero, RECENCIA la regla que quedó lista más tarde,
+// ESPECIFICIDAD la de más condiciones y CERTEZA la de mayor |FC aportado|.
+enum class EstrategiaAgenda { PRIORIDAD, RECENCIA, ESPECIFICIDAD, CERTEZA };
+
+bool parsearEstrategia(const std::string& texto, EstrategiaAgenda& estrategia) {
+    std::string t = toLower(texto);
+    if (t == "prioridad") estrategia = EstrategiaAgenda::PRIORIDAD;
+    else if (t == "recencia") estrategia = EstrategiaAgenda::RECENCIA;
+    else if (t == "especificidad") estrategia = EstrategiaAgenda::ESPECIFICIDAD;
+    else if (t == "certeza") estrategia = EstrategiaAgenda::CERTEZA;
+    else return false;
+    return true;
+}
+
+const char* nombreEstrategia(EstrategiaAgenda estrategia) {
+    switch (estrategia) {
+        case EstrategiaAgenda::PRIORIDAD: return "prioridad";
+        case EstrategiaAgenda::RECENCIA: return "recencia";
+        case EstrategiaAgenda::ESPECIFICIDAD: return "especificidad";
+        case EstrategiaAgenda::CERTEZA: return "certeza";
+    }
+    return "?";
+}
+
+// Montículo binario de máximos sobre ids 0..n-1 que guarda la posición de cada id, de modo
+// que insertar, cambiar la prioridad o retirar un id cualquiera cuesta O(log n). A igual
+// prioridad sale antes el id menor, así el orden de disparo es determinista.
+class AgendaIndexada {
+public:
+    void reiniciar(size_t n) {
+        monticulo.clear();
+        posicion.assign(n, -1);
+    }
+    bool vacia() const { return monticulo.empty(); }
+    size_t tamano() const { return monticulo.size(); }
+    bool contiene(int id) const { return posicion[id] >= 0; }
+
+    // Inserta el id o, si ya está en la agenda, actualiza su prioridad
+    void insertar(int id, double prioridad) {
+        if (posicion[id] >= 0) {
+            size_t i = static_cast<size_t>(posicion[id]);
+            double anterior = monticulo[i].first;
+            monticulo[i].first = prioridad;
+            if (prioridad > anterior) subir(i);
+            else bajar(i);
+            return;
+        }
+        monticulo.emplace_back(prioridad, id);
+        posicion[id] = static_cast<int>(monticulo.size() - 1);
+        subir(monticulo.size() - 1);
+    }
+
+    void retirar(int id) {
+        if (posicion[id] < 0) return;
+        size_t i = static_cast<size_t>(posicion[id]);
+        posicion[id] = -1;
+        Entrada ultima = monticulo.back();
+        monticulo.pop_back();
+        if (i == monticulo.size()) return;
+        colocar(i, ultima);
+        subir(i);
+        bajar(static_cast<size_t>(posicion[ultima.second]));
+    }
+
+    int extraer() {
+        int id = monticulo.front().second;
+        retirar(id);
+        return id;
+    }
+
+private:
+    typedef std::pair<double, int> Entrada; // (prioridad, id)
+    std::vector<Entrada> monticulo;
+    std::vector<int> posicion; // -1 si el id no está en la agenda
+
+    static bool antes(const Entrada& a, const Entrada& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+    void colocar(size_t i, const Entrada& e) {
+        monticulo[i] = e;
+        posicion[e.second] = static_cast<int>(i);
+    }
+    void subir(size_t i) {
+        Entrada e = monticulo[i];
+        while (i > 0) {
+            size_t padre = (i - 1) / 2;
+            if (!antes(e, monticulo[padre])) break;
+            colocar(i, monticulo[padre]);
+            i = padre;
+        }
+        colocar(i, e);
+    }
+    void bajar(size_t i) {
+        Entrada e = monticulo[i];
+        size_t n = monticulo.size();
+        while (2 * i + 1 < n) {
+            size_t hijo = 2 * i + 1;
+            if (hijo + 1 < n && antes(monticulo[hijo + 1], monticulo[hijo])) ++hijo;
+            if (!antes(monticulo[hijo], e)) break;
+            colocar(i, monticulo[hijo]);
+            i = hijo;
+        }
+        colocar(i, e);
+    }
+};
+
+// Reglas en cuyo antecedente aparece cada símbolo (una entrada por aparición). Es el índice
+// inverso de inicioCondiciones/condiciones y se construye una vez por base compilada.
+struct IndiceHaciaDelante {
+    std::vector<int> inicioUsos;
+    std::vector<int> usos;
+};
+
+void construirIndiceHaciaDelante(const BaseCompilada& bcc, IndiceHaciaDelante& indice) {
+    size_t n = bcc.simbolos.size();
+    indice.inicioUsos.assign(n + 1, 0);
+    for (int s : bcc.condiciones) indice.inicioUsos[s + 1]++;
+    for (size_t s = 0; s < n; ++s) indice.inicioUsos[s + 1] += indice.inicioUsos[s];
+    indice.usos.assign(bcc.condiciones.size(), 0);
+    std::vector<int> siguiente(indice.inicioUsos.begin(), indice.inicioUsos.end() - 1);
+    for (size_t r = 0; r + 1 < bcc.inicioCondiciones.size(); ++r) {
+        for (int c = bcc.inicioCondiciones[r]; c < bcc.inicioCondiciones[r + 1]; ++c) {
+            indice.usos[siguiente[bcc.condiciones[c]]++] = static_cast<int>(r);
+        }
+    }
+}
+
+struct OpcionesHaciaDelante {
+    EstrategiaAgenda estrategia = EstrategiaAgenda::PRIORIDAD;
+    int64_t plazoNs = 0; // 0: sin plazo
+};
+
+struct EstadoHaciaDelante {
+    EstadoInferencia hechos; // Carga de hechos iniciales y numéricos, como el motor hacia atrás
+    std::vector<double> fc;
+    std::vector<uint8_t> concluido;          // Por símbolo: su FC ya no puede cambiar
+    std::vector<int> reglasPendientes;       // Por símbolo: reglas que aún pueden aportarle
+    std::vector<int> condicionesPendientes;  // Por regla: condiciones sin concluir
+    std::vector<uint8_t> retirada;           // Por regla: disparada o descartada
+    std::vector<std::vector<std::pair<int, double>>> aportaciones; // Por símbolo: (origen, FC)
+    std::vector<int> porConcluir;
+    AgendaIndexada agenda;
+    double recencia = 0;
+    std::vector<uint32_t> visita; // Búsqueda de ciclos, con marca por búsqueda
+    uint32_t marca = 0;
+
+    // Resultado de la última consulta
+    bool objetivoConcluido = false;
+    bool plazoAgotado = false;
+    uint64_t disparos = 0;   // Reglas disparadas (con o sin aportación)
+    uint64_t descartes = 0;  // Reglas retiradas sin dispararse
+    int64_t nsObjetivo = 0;  // Tiempo hasta concluir el objetivo
+};
+
+// Motor guiado por los datos: una regla entra en la agenda cuando su antecedente ya no puede
+// cambiar (todas sus condiciones concluidas, o una que decide: <= 0 en una Y, >= 1 en una O)
+// y un símbolo se concluye cuando ya no le queda ninguna regla por disparar. Las aportaciones
+// se combinan en orden de fichero al concluir, así que sobre una BC acíclica el FC coincide con
+// el del encadenamiento hacia atrás sea cual sea la estrategia; ésta sólo decide cuándo se
+// llega a cada conclusión. La consulta termina al concluir el objetivo o al agotar el plazo.
+// Si la agenda se vacía con símbolos bloqueados en un ciclo, se concluye uno del ciclo con
+// lo que ya tenga, igual que el motor hacia atrás da 0 al cerrar un ciclo (aunque el símbolo
+// que se rompe puede no ser el mismo y el FC diferir).
+template <typename Calculo = CalculoMycin>
+double encadenarHaciaDelante(const BaseCompilada& bcc, const IndiceHaciaDelante& indice,
+                             BaseHechos& bh, EstadoHaciaDelante& est, const OpcionesHaciaDelante& opciones) {
+    int64_t t0 = relojNs();
+    est.objetivoConcluido = false;
+    est.plazoAgotado = false;
+    est.disparos = 0;
+    est.descartes = 0;
+    est.nsObjetivo = 0;
+
+    int objetivo = buscarSimbolo(bcc, bh.objetivo.nombre);
+    if (objetivo < 0) {
+        auto it = bh.fc_memoria.find(bh.objetivo.nombre);
+        double resultado = it == bh.fc_memoria.end() ? 0.0 : it->second;
+        est.objetivoConcluido = true;
+        bh.objetivo.factorCerteza = resultado;
+        bh.fc_memoria[bh.objetivo.nombre] = resultado;
+        return resultado;
+    }
+
+    EstadoInferencia& h = est.hechos;
+    prepararEstado(bcc, bh, h);
+    size_t n = bcc.simbolos.size(), m = bcc.fcRegla.size();
+    est.fc.assign(n, 0.0);
+    est.concluido.assign(n, 0);
+    est.reglasPendientes.assign(n, 0);
+    est.condicionesPendientes.assign(m, 0);
+    est.retirada.assign(m, 0);
+    est.aportaciones.resize(n);
+    for (auto& a : est.aportaciones) a.clear();
+    est.porConcluir.clear();
+    est.agenda.reiniciar(m);
+    est.recencia = 0;
+    if (est.visita.size() != n) {
+        est.visita.assign(n, 0);
+        est.marca = 0;
+    }
+
+    auto antecedente = [&](int r) {
+        bool esO = bcc.operadorRegla[r] == OperadorLogico::O;
+        double valor = 0.0;
+        bool primera = true;
+        for (int c = bcc.inicioCondiciones[r]; c < bcc.inicioCondiciones[r + 1]; ++c) {
+            int s = bcc.condiciones[c];
+            if (!est.concluido[s]) continue; // Sólo en una O ya decidida
+            valor = primera ? est.fc[s] : (esO ? Calculo::o(valor, est.fc[s]) : Calculo::y(valor, est.fc[s]));
+            primera = false;
+        }
+        return valor;
+    };
+    auto activar = [&](int r) {
+        double prioridad = 0.0;
+        switch (opciones.estrategia) {
+            case EstrategiaAgenda::PRIORIDAD: prioridad = bcc.prioridadRegla[r]; break;
+            case EstrategiaAgenda::RECENCIA: prioridad = ++est.recencia; break;
+            case EstrategiaAgenda::ESPECIFICIDAD:
+                prioridad = bcc.inicioCondiciones[r + 1] - bcc.inicioCondiciones[r]; break;
+            case EstrategiaAgenda::CERTEZA: {
+                double a = antecedente(r);
+                prioridad = a > 0.0 ? std::abs(Calculo::encadenar(bcc.fcRegla[r], a)) : 0.0;
+                break;
+            }
+        }
+        est.agenda.insertar(r, prioridad);
+    };
+    auto cerrarRegla = [&](int r) { // La regla ya no aportará nada más a su consecuente
+        est.retirada[r] = 1;
+        int s = bcc.consecuenteRegla[r];
+        if (!est.concluido[s] && --est.reglasPendientes[s] == 0) est.porConcluir.push_back(s);
+    };
+    auto descartar = [&](int r) {
+        est.agenda.retirar(r);
+        est.descartes++;
+        cerrarRegla(r);
+    };
+
+    // Hechos iniciales, atributos conocidos y símbolos sin reglas están concluidos desde el inicio
+    for (size_t s = 0; s < n; ++s) {
+        int atributo = bcc.atributoDe[s];
+        if (h.epocaHecho[s] == h.epocaHechosActual) {
+            est.fc[s] = h.fcHecho[s];
+            est.concluido[s] = 1;
+        } else if (atributo >= 0 && h.epocaAtributo[atributo] == h.epocaHechosActual) {
+            est.fc[s] = -h.fcAtributo[atributo];
+            est.concluido[s] = 1;
+        } else {
+            est.reglasPendientes[s] = bcc.inicioReglasDe[s + 1] - bcc.inicioReglasDe[s];
+            est.concluido[s] = est.reglasPendientes[s] == 0;
+        }
+    }
+    for (size_t r = 0; r < m; ++r) {
+        if (est.concluido[bcc.consecuenteRegla[r]]) { // Un hecho inicial prevalece sobre las reglas
+            est.retirada[r] = 1;
+            continue;
+        }
+        bool esO = bcc.operadorRegla[r] == OperadorLogico::O;
+        bool decide = false;
+        for (int c = bcc.inicioCondiciones[r]; c < bcc.inicioCondiciones[r + 1]; ++c) {
+            int s = bcc.condiciones[c];
+            if (!est.concluido[s]) est.condicionesPendientes[r]++;
+            else if (esO ? est.fc[s] >= 1.0 : est.fc[s] <= 0.0) decide = true;
+        }
+        if (decide && !esO) descartar(static_cast<int>(r));
+        else if (decide || est.condicionesPendientes[r] == 0) activar(static_cast<int>(r));
+    }
+
+    est.objetivoConcluido = est.concluido[objetivo] != 0;
+    size_t bloqueado = 0; // Cursor para desbloquear ciclos
+    while (true) {
+        while (!est.porConcluir.empty()) {
+            int s = est.porConcluir.back();
+            est.porConcluir.pop_back();
+            if (est.concluido[s]) continue;
+            auto& lista = est.aportaciones[s];
+            std::sort(lista.begin(), lista.end()); // Orden de fichero, como evaluarSimbolo
+            double resultado = 0.0;
+            for (size_t k = 0; k < lista.size(); ++k) resultado = k == 0 ? lista[k].second : Calculo::combinar(resultado, lista[k].second);
+            est.fc[s] = resultado;
+            est.concluido[s] = 1;
+            if (s == objetivo) {
+                est.objetivoConcluido = true;
+                est.nsObjetivo = relojNs() - t0;
+            }
+            bool positivo = resultado >= 1.0, noPositivo = resultado <= 0.0;
+            for (int k = indice.inicioUsos[s]; k < indice.inicioUsos[s + 1]; ++k) {
+                int r = indice.usos[k];
+                if (est.retirada[r] || est.agenda.contiene(r)) continue;
+                bool esO = bcc.operadorRegla[r] == OperadorLogico::O;
+                --est.condicionesPendientes[r];
+                if (!esO && noPositivo) descartar(r);
+                else if ((esO && positivo) || est.condicionesPendientes[r] == 0) activar(r);
+            }
+        }
+        if (est.objetivoConcluido) break;
+        if (opciones.plazoNs > 0 && (est.disparos & 63) == 0 && relojNs() - t0 > opciones.plazoNs) {
+            est.plazoAgotado = true;
+            break;
+        }
+        if (est.agenda.vacia()) {
+            while (bloqueado < n && est.concluido[bloqueado]) ++bloqueado;
+            if (bloqueado == n) break; // No debería ocurrir: el objetivo estaría concluido
+            // Seguir condiciones sin concluir hasta repetir un símbolo, que está en un ciclo.
+            // Con la agenda vacía, toda regla pendiente tiene alguna condición sin concluir.
+            int s = static_cast<int>(bloqueado);
+            if (++est.marca == 0) {
+                std::fill(est.visita.begin(), est.visita.end(), 0);
+                est.marca = 1;
+            }
+            while (est.visita[s] != est.marca) {
+                est.visita[s] = est.marca;
+                int siguiente = -1;
+                for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1] && siguiente < 0; ++k) {
+                    int r = bcc.reglasDe[k];
+                    if (est.retirada[r]) continue;
+                    for (int c = bcc.inicioCondiciones[r]; c < bcc.inicioCondiciones[r + 1]; ++c) {
+                        if (!est.concluido[bcc.condiciones[c]]) {
+                            siguiente = bcc.condiciones[c];
+                            break;
+                        }
+                    }
+                }
+                if (siguiente < 0) break;
+                s = siguiente;
+            }
+            for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1]; ++k) est.retirada[bcc.reglasDe[k]] = 1;
+            est.reglasPendientes[s] = 0;
+            est.porConcluir.push_back(s);
+            continue;
+        }
+
+        int r = est.agenda.extraer();
+        est.disparos++;
+        double a = antecedente(r);
+        int s = bcc.consecuenteRegla[r];
+        if (a > 0.0) {
+            double aportacion = Calculo::encadenar(bcc.fcRegla[r], a);
+            SBR_SONDA2(regla_disparo, bcc.origenRegla[r], s);
+            est.aportaciones[s].emplace_back(bcc.origenRegla[r], aportacion);
+            if (Calculo::satura(aportacion, bcc.saturable[s])) {
+                // Saturado: las demás reglas del símbolo no pueden cambiar el resultado
+                for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1]; ++k) {
+                    int otra = bcc.reglasDe[k];
+                    if (est.retirada[otra] || otra == r) continue;
+                    est.agenda.retirar(otra);
+                    est.retirada[otra] = 1;
+                    est.descartes++;
+                }
+                est.retirada[r] = 1;
+                est.reglasPendientes[s] = 0;
+                est.porConcluir.push_back(s);
+                continue;
+            }
+        }
+        cerrarRegla(r);
+    }
+
+    double resultado = est.objetivoConcluido ? est.fc[objetivo] : 0.0;
+    if (est.objetivoConcluido) {
+        bh.objetivo.factorCerteza = resultado;
+        bh.fc_memoria[bh.objetivo.nombre] = resultado;
+    }
+    return resultado;
+}
+
+double encadenarHaciaDelante(TipoCalculo calculo, const BaseCompilada& bcc, const IndiceHaciaDelante& indice,
+                             BaseHechos& bh, EstadoHaciaDelante& est, const OpcionesHaciaDelante& opciones) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: return encadenarHaciaDelante<CalculoDifuso>(bcc, indice, bh, est, opciones);
+        case TipoCalculo::PROBABILISTICO: return encadenarHaciaDelante<CalculoProbabilistico>(bcc, indice, bh, est, opciones);
+        case TipoCalculo::LUKASIEWICZ: return encadenarHaciaDelante<CalculoLukasiewicz>(bcc, indice, bh, est, opciones);
+        case TipoCalculo::MYCIN: break;
+    }
+    return encadenarHaciaDelante<CalculoMycin>(bcc, indice, bh, est, opciones);
+}
+
+
+// --- Punto Fijo sobre Componentes Cíclicas ---
+
+// Componentes fuertemente conexas del grafo de dependencias (un símbolo depende de las
+// condiciones de sus reglas), numeradas en el orden en que Tarjan las cierra: las
+// dependencias de una componente siempre tienen un número menor.
+struct ComponentesFuertes {
+    std::vector<int> componente;      // Por símbolo
+    std::vector<int> inicioMiembros;  // Miembros de c en [inicioMiembros[c], inicioMiembros[c+1])
+    std::vector<int> miembros;
+    std::vector<uint8_t> ciclica;     // Más de un miembro, o un símbolo que depende de sí mismo
+};
+
+// Tarjan con la pila de la DFS explícita: las cadenas de reglas de las BCs grandes
+// desbordarían la pila de llamadas
+void calcularComponentes(const BaseCompilada& bcc, ComponentesFuertes& cf) {
+    size_t n = bcc.simbolos.size();
+    std::vector<int> orden(n, -1), bajo(n, 0);
+    std::vector<uint8_t> enPila(n, 0);
+    std::vector<int> pila;
+    struct Marco { int s; int k; int c; }; // Símbolo y siguiente (regla, condición) por visitar
+    std::vector<Marco> marcos;
+    cf.componente.assign(n, -1);
+    cf.inicioMiembros.assign(1, 0);
+    cf.miembros.clear();
+    cf.ciclica.clear();
+    int contador = 0;
+    auto visitar = [&](int s) {
+        orden[s] = bajo[s] = contador++;
+        pila.push_back(s);
+        enPila[s] = 1;
+        marcos.push_back({s, bcc.inicioReglasDe[s], -1});
+    };
+    for (size_t raiz = 0; raiz < n; ++raiz) {
+        if (orden[raiz] >= 0) continue;
+        visitar(static_cast<int>(raiz));
+        while (!marcos.empty()) {
+            Marco& m = marcos.back();
+            int sucesor = -1;
+            while (m.k < bcc.inicioReglasDe[m.s + 1]) {
+                int r = bcc.reglasDe[m.k];
+                if (m.c < 0) m.c = bcc.inicioCondiciones[r];
+                if (m.c < bcc.inicioCondiciones[r + 1]) {
+                    sucesor = bcc.condiciones[m.c++];
+                    break;
+                }
+                ++m.k;
+                m.c = -1;
+            }
+            if (sucesor >= 0) {
+                if (orden[sucesor] < 0) visitar(sucesor);
+                else if (enPila[sucesor]) bajo[m.s] = std::min(bajo[m.s], orden[sucesor]);
+                continue;
+            }
+            int s = m.s;
+            marcos.pop_back();
+            if (!marcos.empty()) bajo[marcos.back().s] = std::min(bajo[marcos.back().s], bajo[s]);
+            if (bajo[s] != orden[s]) continue;
+            int c = static_cast<int>(cf.ciclica.size());
+            int t;
+            do {
+                t = pila.back();
+                pila.pop_back();
+                enPila[t] = 0;
+                cf.componente[t] = c;
+                cf.miembros.push_back(t);
+            } while (t != s);
+            bool ciclica = cf.miembros.size() - cf.inicioMiembros.back() > 1;
+            for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1] && !ciclica; ++k) {
+                int r = bcc.reglasDe[k];
+                for (int cond = bcc.inicioCondiciones[r]; cond < bcc.inicioCondiciones[r + 1]; ++cond) {
+                    if (bcc.condiciones[cond] == s) ciclica = true;
+                }
+            }
+            cf.ciclica.push_back(ciclica);
+            cf.inicioMiembros.push_back(static_cast<int>(cf.miembros.size()));
+        }
+    }
+}
+
+struct OpcionesPuntoFijo {
+    double tolerancia = 1e-9;   // Un cambio menor no vuelve a encolar a los dependientes
+    int maxIteraciones = 1000;  // Evaluaciones por miembro de una componente antes de rendirse
+};
+
+struct EstadoPuntoFijo {
+    EstadoInferencia hechos; // Carga de hechos iniciales y numéricos, como el motor hacia atrás
+    std::vector<double> fc;
+    std::vector<uint32_t> epocaComponente; // Componentes del cono del objetivo en esta consulta
+    uint32_t epocaActual = 0;
+    std::vector<int> necesarias;
+    std::deque<int> pendientes;            // Lista de trabajo de la componente en curso
+    std::vector<uint8_t> enCola;
+    std::vector<std::pair<int, double>> contribuciones;
+
+    // Resultado de la última consulta
+    uint64_t evaluaciones = 0;
+    int componentesCiclicas = 0;
+    int sinConverger = 0;
+};
+
+// Evalúa el objetivo recorriendo las componentes de su cono de dependencias de las hojas
+// hacia arriba. Una componente acíclica se evalúa una vez, como en el encadenamiento hacia
+// atrás; en una cíclica los símbolos parten de 0 y se recalculan por Gauss-Seidel (cada
+// evaluación usa ya los valores nuevos) con una lista de trabajo: sólo se vuelve a evaluar
+// un símbolo cuando cambia en más de la tolerancia alguna condición de sus reglas. Así se
+// llega al menor punto fijo desde 0, en vez del 0 con que el motor hacia atrás corta un ciclo.
+template <typename Calculo = CalculoMycin>
+double evaluarPuntoFijo(const BaseCompilada& bcc, const ComponentesFuertes& cf, const IndiceHaciaDelante& indice,
+                        BaseHechos& bh, EstadoPuntoFijo& est, const OpcionesPuntoFijo& opciones) {
+    est.evaluaciones = 0;
+    est.componentesCiclicas = 0;
+    est.sinConverger = 0;
+    int objetivo = buscarSimbolo(bcc, bh.objetivo.nombre);
+    if (objetivo < 0) return motorDeInferencia<Calculo>(bcc, bh, est.hechos);
+
+    EstadoInferencia& h = est.hechos;
+    prepararEstado(bcc, bh, h);
+    size_t n = bcc.simbolos.size(), numComponentes = cf.ciclica.size();
+    if (est.fc.size() != n || est.epocaComponente.size() != numComponentes) {
+        est.fc.assign(n, 0.0);
+        est.enCola.assign(n, 0);
+        est.epocaComponente.assign(numComponentes, 0);
+        est.epocaActual = 0;
+    }
+    if (++est.epocaActual == 0) {
+        std::fill(est.epocaComponente.begin(), est.epocaComponente.end(), 0);
+        est.epocaActual = 1;
+    }
+    auto constante = [&](int s, double& valor) { // Hecho inicial o comparación sobre un atributo conocido
+        if (h.epocaHecho[s] == h.epocaHechosActual) {
+            valor = h.fcHecho[s];
+            return true;
+        }
+        int atributo = bcc.atributoDe[s];
+        if (atributo >= 0 && h.epocaAtributo[atributo] == h.epocaHechosActual) {
+            valor = -h.fcAtributo[atributo];
+            return true;
+        }
+        return false;
+    };
+    auto evaluar = [&](int s) { // Casos 1-3 con los valores actuales de las condiciones
+        est.evaluaciones++;
+        est.contribuciones.clear();
+        for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1]; ++k) {
+            int r = bcc.reglasDe[k];
+            bool esO = bcc.operadorRegla[r] == OperadorLogico::O;
+            double antecedente = 0.0;
+            for (int c = bcc.inicioCondiciones[r]; c < bcc.inicioCondiciones[r + 1]; ++c) {
+                double valor = est.fc[bcc.condiciones[c]];
+                antecedente = c == bcc.inicioCondiciones[r] ? valor : (esO ? Calculo::o(antecedente, valor) : Calculo::y(antecedente, valor));
+            }
+            if (antecedente > 0.0) est.contribuciones.emplace_back(bcc.origenRegla[r], Calculo::encadenar(bcc.fcRegla[r], antecedente));
+        }
+        std::sort(est.contribuciones.begin(), est.contribuciones.end());
+        double resultado = 0.0;
+        for (size_t k = 0; k < est.contribuciones.size(); ++k) {
+            resultado = k == 0 ? est.contribuciones[k].second : Calculo::combinar(resultado, est.contribuciones[k].second);
+        }
+        return resultado;
+    };
+
+    // Cono del objetivo, por componentes
+    est.necesarias.assign(1, cf.componente[objetivo]);
+    est.epocaComponente[cf.componente[objetivo]] = est.epocaActual;
+    for (size_t i = 0; i < est.necesarias.size(); ++i) {
+        int c = est.necesarias[i];
+        for (int k = cf.inicioMiembros[c]; k < cf.inicioMiembros[c + 1]; ++k) {
+            int s = cf.miembros[k];
+            double valor;
+            if (constante(s, valor)) continue;
+            for (int j = bcc.inicioReglasDe[s]; j < bcc.inicioReglasDe[s + 1]; ++j) {
+                int r = bcc.reglasDe[j];
+                for (int cond = bcc.inicioCondiciones[r]; cond < bcc.inicioCondiciones[r + 1]; ++cond) {
+                    int d = cf.componente[bcc.condiciones[cond]];
+                    if (est.epocaComponente[d] == est.epocaActual) continue;
+                    est.epocaComponente[d] = est.epocaActual;
+                    est.necesarias.push_back(d);
+                }
+            }
+        }
+    }
+    std::sort(est.necesarias.begin(), est.necesarias.end());
+
+    for (int c : est.necesarias) {
+        int inicio = cf.inicioMiembros[c], fin = cf.inicioMiembros[c + 1];
+        if (!cf.ciclica[c]) {
+            int s = cf.miembros[inicio];
+            double valor;
+            est.fc[s] = constante(s, valor) ? valor : evaluar(s);
+            continue;
+        }
+        est.componentesCiclicas++;
+        for (int k = inicio; k < fin; ++k) {
+            int s = cf.miembros[k];
+            double valor;
+            if (constante(s, valor)) {
+                est.fc[s] = valor;
+                continue;
+            }
+            est.fc[s] = 0.0;
+            est.pendientes.push_back(s);
+            est.enCola[s] = 1;
+        }
+        uint64_t limite = static_cast<uint64_t>(std::max(1, opciones.maxIteraciones)) * (fin - inicio);
+        uint64_t evaluadas = 0;
+        while (!est.pendientes.empty()) {
+            if (evaluadas++ == limite) {
+                est.sinConverger++;
+                for (int s : est.pendientes) est.enCola[s] = 0;
+                est.pendientes.clear();
+                break;
+            }
+            int s = est.pendientes.front();
+            est.pendientes.pop_front();
+            est.enCola[s] = 0;
+            double nuevo = evaluar(s);
+            double cambio = std::abs(nuevo - est.fc[s]);
+            est.fc[s] = nuevo;
+            if (cambio <= opciones.tolerancia) continue;
+            for (int k = indice.inicioUsos[s]; k < indice.inicioUsos[s + 1]; ++k) {
+                int t = bcc.consecuenteRegla[indice.usos[k]];
+                double valor;
+                if (cf.componente[t] != c || est.enCola[t] || constante(t, valor)) continue;
+                est.pendientes.push_back(t);
+                est.enCola[t] = 1;
+            }
+        }
+    }
+
+    double resultado = est.fc[objetivo];
+    bh.objetivo.factorCerteza = resultado;
+    bh.fc_memoria[bh.objetivo.nombre] = resultado;
+    return resultado;
+}
+
+double evaluarPuntoFijo(TipoCalculo calculo, const BaseCompilada& bcc, const ComponentesFuertes& cf,
+                        const IndiceHaciaDelante& indice, BaseHechos& bh, EstadoPuntoFijo& est,
+                        const OpcionesPuntoFijo& opciones) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: return evaluarPuntoFijo<CalculoDifuso>(bcc, cf, indice, bh, est, opciones);
+        case TipoCalculo::PROBABILISTICO: return evaluarPuntoFijo<CalculoProbabilistico>(bcc, cf, indice, bh, est, opciones);
+        case TipoCalculo::LUKASIEWICZ: return evaluarPuntoFijo<CalculoLukasiewicz>(bcc, cf, indice, bh, est, opciones);
+        case TipoCalculo::MYCIN: break;
+    }
+    return evaluarPuntoFijo<CalculoMycin>(bcc, cf, indice, bh, est, opciones);
+}
+
+
+// --- Evaluación por Bloques ---
+
+// Número de casos que se evalúan a la vez. Los FCs de un bloque se guardan por símbolo
+// (SoA): los kCarriles valores de un símbolo son contiguos y cada operación del cálculo se
+// aplica con un bucle de longitud fija que el compilador puede vectorizar.
+constexpr int kCarriles = 8;
+
+// Lo que la evaluación por bloques necesita de una BC compilada, calculado una vez: las
+// componentes (el orden topológico y los ciclos) y las reglas de cada símbolo en orden de
+// fichero, que es el orden en que se combinan sus aportaciones.
+struct PlanBloques {
+    ComponentesFuertes componentes;
+    std::vector<int> inicioReglas;
+    std::vector<int> reglas;
+};
+
+void prepararPlanBloques(const BaseCompilada& bcc, PlanBloques& plan) {
+    calcularComponentes(bcc, plan.componentes);
+    plan.inicioReglas.assign(bcc.inicioReglasDe.begin(), bcc.inicioReglasDe.end());
+    plan.reglas.assign(bcc.reglasDe.begin(), bcc.reglasDe.end());
+    for (size_t s = 0; s + 1 < plan.inicioReglas.size(); ++s) {
+        std::sort(plan.reglas.begin() + plan.inicioReglas[s], plan.reglas.begin() + plan.inicioReglas[s + 1],
+                  [&](int a, int b) { return bcc.origenRegla[a] < bcc.origenRegla[b]; });
+    }
+}
+
+// Registro de la pasada hacia delante de un bloque, para retropropagar gradientes: por cada
+// regla aplicada, su antecedente y el acumulado del consecuente antes de su aportación
+struct CintaBloque {
+    bool valida = false;             // Falso si el cono tenía un ciclo (no hay pasada por bloques)
+    std::vector<int> inicioSimbolo;  // Reglas del k-ésimo símbolo del cono en [inicioSimbolo[k], inicioSimbolo[k+1])
+    std::vector<int> reglas;
+    std::vector<double> antecedente; // [t * kCarriles + carril]
+    std::vector<double> previo;
+};
+
+struct EstadoBloque {
+    EstadoInferencia carril[kCarriles]; // Hechos de cada caso del bloque
+    std::vector<double> fc;             // fc[s * kCarriles + carril]
+    std::vector<uint32_t> epoca;        // Símbolos del cono de los objetivos en este bloque
+    uint32_t epocaActual = 0;
+    std::vector<int> cono;
+};
+
+// Evalúa hasta kCarriles casos. Se recorre una sola vez la unión de los conos de sus objetivos,
+// de las hojas hacia arriba, y cada regla se aplica a todos los carriles sin cortocircuito: el
+// resultado coincide con el del motor hacia atrás porque las políticas cumplen las condiciones
+// de corte. Si el cono tiene un ciclo, el resultado dependería del orden de evaluación y se
+// resuelve cada caso con el motor hacia atrás.
+template <typename Calculo = CalculoMycin>
+void evaluarBloque(const BaseCompilada& bcc, const PlanBloques& plan, BaseHechos* casos, int numCasos, EstadoBloque& est,
+                   CintaBloque* cinta = nullptr) {
+    size_t n = bcc.simbolos.size();
+    if (est.epoca.size() != n) {
+        est.epoca.assign(n, 0);
+        est.epocaActual = 0;
+        est.fc.assign(n * kCarriles, 0.0);
+    }
+    if (++est.epocaActual == 0) {
+        std::fill(est.epoca.begin(), est.epoca.end(), 0);
+        est.epocaActual = 1;
+    }
+    const ComponentesFuertes& cf = plan.componentes;
+    int objetivo[kCarriles];
+    est.cono.clear();
+    bool ciclico = false;
+    for (int l = 0; l < numCasos; ++l) {
+        objetivo[l] = buscarSimbolo(bcc, casos[l].objetivo.nombre);
+        if (objetivo[l] < 0 || est.epoca[objetivo[l]] == est.epocaActual) continue;
+        est.epoca[objetivo[l]] = est.epocaActual;
+        est.cono.push_back(objetivo[l]);
+    }
+    for (size_t i = 0; i < est.cono.size(); ++i) {
+        int s = est.cono[i];
+        if (cf.ciclica[cf.componente[s]]) ciclico = true;
+        for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1]; ++k) {
+            int r = bcc.reglasDe[k];
+            for (int c = bcc.inicioCondiciones[r]; c < bcc.inicioCondiciones[r + 1]; ++c) {
+                int d = bcc.condiciones[c];
+                if (est.epoca[d] == est.epocaActual) continue;
+                est.epoca[d] = est.epocaActual;
+                est.cono.push_back(d);
+            }
+        }
+    }
+    if (cinta) {
+        cinta->valida = !ciclico;
+        cinta->inicioSimbolo.assign(1, 0);
+        cinta->reglas.clear();
+        cinta->antecedente.clear();
+        cinta->previo.clear();
+    }
+    if (ciclico) {
+        for (int l = 0; l < numCasos; ++l) motorDeInferencia<Calculo>(bcc, casos[l], est.carril[l]);
+        return;
+    }
+    for (int l = 0; l < numCasos; ++l) prepararEstado(bcc, casos[l], est.carril[l]);
+    std::sort(est.cono.begin(), est.cono.end(), [&](int a, int b) { return cf.componente[a] < cf.componente[b]; });
+
+    double antecedente[kCarriles], acumulado[kCarriles];
+    bool dispara[kCarriles], hay[kCarriles];
+    for (int s : est.cono) {
+        double* fc = &est.fc[static_cast<size_t>(s) * kCarriles];
+        for (int l = 0; l < kCarriles; ++l) {
+            hay[l] = false;
+            acumulado[l] = 0.0;
+        }
+        for (int k = plan.inicioReglas[s]; k < plan.inicioReglas[s + 1]; ++k) {
+            int r = plan.reglas[k];
+            int inicio = bcc.inicioCondiciones[r], fin = bcc.inicioCondiciones[r + 1];
+            const double* primera = &est.fc[static_cast<size_t>(bcc.condiciones[inicio]) * kCarriles];
+            for (int l = 0; l < kCarriles; ++l) antecedente[l] = primera[l];
+            for (int c = inicio + 1; c < fin; ++c) {
+                const double* valor = &est.fc[static_cast<size_t>(bcc.condiciones[c]) * kCarriles];
+                if (bcc.operadorRegla[r] == OperadorLogico::O) {
+                    for (int l = 0; l < kCarriles; ++l) antecedente[l] = Calculo::o(antecedente[l], valor[l]);
+                } else {
+                    for (int l = 0; l < kCarriles; ++l) antecedente[l] = Calculo::y(antecedente[l], valor[l]);
+                }
+            }
+            double fcRegla = bcc.fcRegla[r];
+            if (cinta) {
+                cinta->reglas.push_back(r);
+                cinta->antecedente.insert(cinta->antecedente.end(), antecedente, antecedente + kCarriles);
+                for (int l = 0; l < kCarriles; ++l) cinta->previo.push_back(hay[l] ? acumulado[l] : 0.0);
+            }
+            for (int l = 0; l < kCarriles; ++l) {
+                double aportacion = Calculo::encadenar(fcRegla, antecedente[l]);
+                dispara[l] = antecedente[l] > 0.0;
+                acumulado[l] = !dispara[l] ? acumulado[l] : hay[l] ? Calculo::combinar(acumulado[l], aportacion) : aportacion;
+                hay[l] = hay[l] || dispara[l];
+            }
+        }
+        for (int l = 0; l < kCarriles; ++l) fc[l] = hay[l] ? acumulado[l] : 0.0;
+        if (cinta) cinta->inicioSimbolo.push_back(static_cast<int>(cinta->reglas.size()));
+
+        // Hechos iniciales y comparaciones sobre atributos conocidos prevalecen sobre las reglas
+        int atributo = bcc.atributoDe[s];
+        for (int l = 0; l < numCasos; ++l) {
+            const EstadoInferencia& h = est.carril[l];
+            if (h.epocaHecho[s] == h.epocaHechosActual) fc[l] = h.fcHecho[s];
+            else if (atributo >= 0 && h.epocaAtributo[atributo] == h.epocaHechosActual) fc[l] = -h.fcAtributo[atributo];
+        }
+    }
+
+    for (int l = 0; l < numCasos; ++l) {
+        BaseHechos& bh = casos[l];
+        double resultado;
+        if (objetivo[l] >= 0) {
+            resultado = est.fc[static_cast<size_t>(objetivo[l]) * kCarriles + l];
+        } else {
+            auto it = bh.fc_memoria.find(bh.objetivo.nombre);
+            resultado = it == bh.fc_memoria.end() ? 0.0 : it->second;
+        }
+        bh.objetivo.factorCerteza = resultado;
+        bh.fc_memoria[bh.objetivo.nombre] = resultado;
+    }
+}
+
+void evaluarBloque(TipoCalculo calculo, const BaseCompilada& bcc, const PlanBloques& plan,
+                   BaseHechos* casos, int numCasos, EstadoBloque& est) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: evaluarBloque<CalculoDifuso>(bcc, plan, casos, numCasos, est); return;
+        case TipoCalculo::PROBABILISTICO: evaluarBloque<CalculoProbabilistico>(bcc, plan, casos, numCasos, est); return;
+        case TipoCalculo::LUKASIEWICZ: evaluarBloque<CalculoLukasiewicz>(bcc, plan, casos, numCasos, est); return;
+        case TipoCalculo::MYCIN: break;
+    }
+    evaluarBloque<CalculoMycin>(bcc, plan, casos, numCasos, est);
+}
+
+// --- Propagación por Intervalos ---
+
+// Intervalo [extremo[0], extremo[1]] de los FCs posibles de un símbolo. Las operaciones de los
+// cálculos son monótonas en cada argumento, así que se aplican igual a los dos extremos: un
+// bucle de dos carriles que el compilador convierte en una sola operación SIMD.
+struct Intervalo {
+    double extremo[2];
+};
+
+inline Intervalo puntual(double valor) { return Intervalo{{valor, valor}}; }
+
+struct EstadoIntervalos {
+    EstadoInferencia hechos; // Carga de hechos iniciales y numéricos, como el motor hacia atrás
+    std::vector<Intervalo> valor;
+    std::vector<EstadoSimbolo> estado;
+    std::vector<uint32_t> epoca;
+    uint32_t epocaActual = 0;
+    std::vector<std::pair<int, Intervalo>> contribuciones; // Pila (origen de la regla, aportación)
+};
+
+// Como evaluarSimbolo, pero una hoja sin hecho en la BH puede valer cualquier grado del
+// cálculo en vez de 0, y el resultado acota el FC de todas las maneras de completar la BH.
+// Una regla que dispara sólo en parte de los escenarios aporta 0 en los demás, que es neutro
+// al combinar, por eso la combinación parte de 0. Los cortes (conjunción con extremo superior
+// <= 0, disyunción con inferior >= 1, saturación) sólo se toman si valen en todo el intervalo.
+// En BCs acíclicas las cotas están garantizadas (contienen el resultado) pero no son ajustadas:
+// cada extremo se propaga por separado, así que una hoja que alimenta varias reglas se trata
+// como si tomara valores distintos en cada una (con x -> g FC=1 y x -> g FC=-1 y x desconocido
+// sale [-1, 1], aunque toda BH completa da 0). En un ciclo, el motor hacia atrás corta donde
+// lo encuentra y eso depende de los valores.
+template <typename Calculo = CalculoMycin>
+Intervalo evaluarIntervalo(const BaseCompilada& bcc, EstadoIntervalos& est, int s) {
+    if (est.epoca[s] == est.epocaActual) {
+        return est.estado[s] == EstadoSimbolo::CONOCIDO ? est.valor[s] : puntual(0.0); // Ciclo: como el motor
+    }
+    est.epoca[s] = est.epocaActual;
+    const EstadoInferencia& h = est.hechos;
+    int atributo = bcc.atributoDe[s];
+    if (h.epocaHecho[s] == h.epocaHechosActual) {
+        est.valor[s] = puntual(h.fcHecho[s]);
+    } else if (atributo >= 0 && h.epocaAtributo[atributo] == h.epocaHechosActual) {
+        est.valor[s] = puntual(-h.fcAtributo[atributo]);
+    } else if (bcc.inicioReglasDe[s] == bcc.inicioReglasDe[s + 1]) {
+        est.valor[s] = Intervalo{{Calculo::minimo, 1.0}}; // Hoja desconocida
+    } else {
+        est.estado[s] = EstadoSimbolo::EN_CURSO;
+        size_t base = est.contribuciones.size();
+        for (int k = bcc.inicioReglasDe[s]; k < bcc.inicioReglasDe[s + 1]; ++k) {
+            int r = bcc.reglasDe[k];
+            int inicio = bcc.inicioCondiciones[r], fin = bcc.inicioCondiciones[r + 1];
+            bool esO = bcc.operadorRegla[r] == OperadorLogico::O;
+            Intervalo antecedente = puntual(0.0);
+            for (int c = inicio; c < fin; ++c) {
+                Intervalo v = evaluarIntervalo<Calculo>(bcc, est, bcc.condiciones[c]);
+                for (int e = 0; e < 2; ++e) {
+                    antecedente.extremo[e] = c == inicio ? v.extremo[e]
+                                           : esO ? Calculo::o(antecedente.extremo[e], v.extremo[e])
+                                                 : Calculo::y(antecedente.extremo[e], v.extremo[e]);
+                }
+                if (esO ? v.extremo[0] >= 1.0 : v.extremo[1] <= 0.0) break;
+            }
+            if (antecedente.extremo[1] <= 0.0) continue; // No dispara en ningún escenario
+
+            // El encadenamiento es monótono pero puede invertir el orden (FC de regla negativo)
+            double extremo[2];
+            for (int e = 0; e < 2; ++e) {
+                extremo[e] = antecedente.extremo[e] > 0.0 ? Calculo::encadenar(bcc.fcRegla[r], antecedente.extremo[e]) : 0.0;
+            }
+            Intervalo aportacion{{std::min(extremo[0], extremo[1]), std::max(extremo[0], extremo[1])}};
+            est.contribuciones.emplace_back(bcc.origenRegla[r], aportacion);
+            double lo = aportacion.extremo[0], hi = aportacion.extremo[1];
+            if (Calculo::satura(lo, bcc.saturable[s]) && Calculo::satura(hi, bcc.saturable[s]) && (lo > 0) == (hi > 0)) break;
+        }
+        auto inicio = est.contribuciones.begin() + base;
+        std::sort(inicio, est.contribuciones.end(),
+                  [](const std::pair<int, Intervalo>& a, const std::pair<int, Intervalo>& b) { return a.first < b.first; });
+        Intervalo resultado = puntual(0.0);
+        for (auto it = inicio; it != est.contribuciones.end(); ++it) {
+            for (int e = 0; e < 2; ++e) resultado.extremo[e] = Calculo::combinar(resultado.extremo[e], it->second.extremo[e]);
+        }
+        est.contribuciones.resize(base);
+        est.valor[s] = resultado;
+    }
+    est.estado[s] = EstadoSimbolo::CONOCIDO;
+    return est.valor[s];
+}
+
+template <typename Calculo = CalculoMycin>
+Intervalo inferirIntervalo(const BaseCompilada& bcc, const BaseHechos& bh, EstadoIntervalos& est) {
+    int objetivo = buscarSimbolo(bcc, bh.objetivo.nombre);
+    if (objetivo < 0) {
+        auto it = bh.fc_memoria.find(bh.objetivo.nombre);
+        return it == bh.fc_memoria.end() ? Intervalo{{Calculo::minimo, 1.0}} : puntual(it->second);
+    }
+    prepararEstado(bcc, bh, est.hechos);
+    size_t n = bcc.simbolos.size();
+    if (est.epoca.size() != n) {
+        est.valor.assign(n, puntual(0.0));
+        est.estado.assign(n, EstadoSimbolo::DESCONOCIDO);
+        est.epoca.assign(n, 0);
+        est.epocaActual = 0;
+    }
+    if (++est.epocaActual == 0) {
+        std::fill(est.epoca.begin(), est.epoca.end(), 0);
+        est.epocaActual = 1;
+    }
+    est.contribuciones.clear();
+    return evaluarIntervalo<Calculo>(bcc, est, objetivo);
+}
+
+Intervalo inferirIntervalo(TipoCalculo calculo, const BaseCompilada& bcc, const BaseHechos& bh, EstadoIntervalos& est) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: return inferirIntervalo<CalculoDifuso>(bcc, bh, est);
+        case TipoCalculo::PROBABILISTICO: return inferirIntervalo<CalculoProbabilistico>(bcc, bh, est);
+        case TipoCalculo::LUKASIEWICZ: return inferirIntervalo<CalculoLukasiewicz>(bcc, bh, est);
+        case TipoCalculo::MYCIN: break;
+    }
+    return inferirIntervalo<CalculoMycin>(bcc, bh, est);
+}
+
+// --- Explicación de Consultas en JSON ---
+
+std::string escaparJson(const std::string& texto) {
+    std::string res;
+    for (unsigned char c : texto) {
+        if (c == '"' || c == '\\') { res += '\\'; res += static_cast<char>(c); }
+        else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            res += buf;
+        } else res += static_cast<char>(c);
+    }
+    return res;
+}
+
+static void escribirNodoJson(std::ostream& os, const BaseCompilada& bcc, const ExplicacionConsulta& ex, int nodo) {
+    static const char* nombresMemo[] = {"fallo", "acierto", "hecho", "ciclo"};
+    const NodoExplicacion& n = ex.nodos[nodo];
+    os << "{\"simbolo\":\"" << escaparJson(bcc.simbolos[n.simbolo]) << "\""
+       << ",\"profundidad\":" << n.profundidad
+       << ",\"memo\":\"" << nombresMemo[static_cast<int>(n.memo)] << "\""
+       << ",\"fc\":" << n.fc
+       << ",\"ns\":" << n.ns;
+    if (n.memo == ResultadoMemo::FALLO) {
+        os << ",\"reglasConsideradas\":" << n.reglasConsideradas
+           << ",\"reglasDisparadas\":" << n.reglasDisparadas
+           << ",\"reglasPodadas\":" << n.reglasPodadas
+           << ",\"condicionesPodadas\":" << n.condicionesPodadas;
+    }
+    if (!n.hijos.empty()) {
+        os << ",\"hijos\":[";
+        for (size_t i = 0; i < n.hijos.size(); ++i) {
+            if (i) os << ',';
+            escribirNodoJson(os, bcc, ex, n.hijos[i]);
+        }
+        os << ']';
+    }
+    os << '}';
+}
+
+// Escribe la consulta explicada como un objeto JSON en una sola línea (formato JSON Lines)
+void escribirExplicacionJson(std::ostream& os, const BaseCompilada& bcc, const BaseHechos& bh,
+                             const ExplicacionConsulta& ex) {
+    os << "{\"objetivo\":\"" << escaparJson(bh.objetivo.nombre) << "\",\"fc\":" << bh.objetivo.factorCerteza
+       << ",\"nodos\":" << ex.nodos.size() << ",\"arbol\":";
+    if (ex.nodos.empty()) os << "null";
+    else escribirNodoJson(os, bcc, ex, 0);
+    os << "}\n";
+}
+
+
+// --- Estadísticas por Regla ---
+
+// Campo CSV entre comillas (RFC 4180): las comillas internas se duplican
+std::string escaparCsv(const std::string& texto) {
+    std::string res = "\"";
+    for (char c : texto) {
+        if (c == '"') res += '"';
+        res += c;
+    }
+    return res + '"';
+}
+
+// CSV con una fila por regla; fraccion_tiempo es su parte del tiempo propio total
+bool exportarEstadisticasCsv(const std::string& nombreArchivo, const BaseConocimiento& bc, const PerfilReglas& perfil) {
+    std::ofstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo de estadísticas: " << nombreArchivo << std::endl;
+        return false;
+    }
+    uint64_t nsTotal = 0;
+    for (const auto& c : perfil.reglas) nsTotal += c.ns;
+    archivo << "id,evaluaciones,disparos,aportaciones_no_positivas,cortocircuitos,saturaciones,ns,fraccion_tiempo\n";
+    for (size_t r = 0; r < perfil.reglas.size(); ++r) {
+        const ContadoresRegla& c = perfil.reglas[r];
+        archivo << escaparCsv(bc.reglas[r].id) << ',' << c.evaluaciones << ',' << c.disparos << ','
+                << c.noPositivas << ',' << c.cortocircuitos << ',' << c.saturaciones << ',' << c.ns << ','
+                << (nsTotal ? static_cast<double>(c.ns) / nsTotal : 0.0) << '\n';
+    }
+    return true;
+}
+
+// Grafo de reglas en Graphviz: hechos como elipses, reglas como cajas coloreadas de blanco
+// a rojo según su parte del tiempo (relativa a la regla más cara)
+bool exportarGrafoCoste(const std::string& nombreArchivo, const BaseConocimiento& bc, const PerfilReglas& perfil) {
+    std::ofstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo del grafo: " << nombreArchivo << std::endl;
+        return false;
+    }
+    uint64_t nsTotal = 0, nsMaximo = 0;
+    for (const auto& c : perfil.reglas) {
+        nsTotal += c.ns;
+        nsMaximo = std::max(nsMaximo, c.ns);
+    }
+    auto hecho = [](const std::string& nombre) { return "\"h:" + escaparJson(nombre) + "\""; };
+    archivo << "digraph reglas {\n  rankdir=BT;\n  node [fontname=\"Helvetica\"];\n";
+    for (size_t r = 0; r < bc.reglas.size(); ++r) {
+        const Regla& regla = bc.reglas[r];
+        const ContadoresRegla& c = perfil.reglas[r];
+        double calor = nsMaximo ? static_cast<double>(c.ns) / nsMaximo : 0.0;
+        archivo << "  \"r:" << escaparJson(regla.id) << "\" [shape=box, style=filled, fillcolor=\"0.000 "
+                << calor << " 1.000\", label=\"" << escaparJson(regla.id) << "\\n"
+                << (nsTotal ? 100.0 * c.ns / nsTotal : 0.0) << "% / " << c.evaluaciones << " ev\"];\n";
+        for (const auto& cond : regla.antecedente.condiciones) {
+            archivo << "  " << hecho(cond.nombre) << " -> \"r:" << escaparJson(regla.id) << "\";\n";
+        }
+        archivo << "  \"r:" << escaparJson(regla.id) << "\" -> " << hecho(regla.consecuente.nombre) << ";\n";
+    }
+    archivo << "}\n";
+    return true;
+}
+
+
+// Prueba-1 del enunciado (prueba1/BC-1.txt y BH-1.txt), cuyo resultado conocido es h1 = 0.66
+static constexpr char kReglasPrueba1[] =
+    "4\n"
+    "R1: Si h2 o h3 Entonces h1, FC=0.5\n"
+    "R2: Si h4 Entonces h1, FC=1\n"
+    "R3: Si h5 y h6 Entonces h3, FC=0.7\n"
+    "R4: Si h7 Entonces h3, FC=-0.5\n";
+static const char* kHechosPrueba1 =
+    "5\nh2, FC=0.3\nh4, FC=0.6\nh5, FC=0.6\nh6, FC=0.9\nh7, FC=0.5\nObjetivo\nh1\n";
+static constexpr double kResultadoPrueba1 = 0.66;
+
+
+// --- BC Embebida en Tiempo de Compilación ---
+
+// Para despliegues sin sistema de ficheros: una BC pequeña escrita como literal se traduce a
+// tablas estáticas al compilar, sin parseo al arrancar ni memoria dinámica al consultar:
+//   static constexpr char kBc[] = "2\nR1: Si a y b Entonces c, FC=0.8\nR2: Si c Entonces d, FC=0.5\n";
+//   constexpr const auto& bc = bcEmbebida<kBc>;
+//   auto hechos = bc.sinHechos();           // FC por símbolo, NaN = sin hecho
+//   hechos[bc.simbolo("a")] = 0.9;
+//   double fc = evaluarEmbebida(bc, hechos, bc.simbolo("d"));
+// Acepta la parte proposicional de la gramática de cargarReglas (condiciones unidas por "y" o
+// por "o", FC y prioridad opcional, palabras clave sin distinguir mayúsculas). Las
+// comparaciones, los átomos con argumentos, las plantillas y mezclar "y" con "o" son errores.
+// Un error en el literal es un error de compilación: el parser llama a errorBcEmbebida, que no
+// es constexpr, y el compilador señala la llamada con el motivo.
+
+inline void errorBcEmbebida(const char* motivo) {
+    std::cerr << "Error en BC embebida: " << motivo << std::endl;
+    std::abort();
+}
+
+constexpr bool esEspacioEmbebida(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+constexpr char minusculaEmbebida(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+constexpr std::string_view recortarEmbebida(std::string_view texto) {
+    while (!texto.empty() && esEspacioEmbebida(texto.front())) texto.remove_prefix(1);
+    while (!texto.empty() && esEspacioEmbebida(texto.back())) texto.remove_suffix(1);
+    return texto;
+}
+
+// Posición de `patron` en `texto` desde `desde` sin distinguir mayúsculas, o npos
+constexpr size_t buscarEmbebida(std::string_view texto, std::string_view patron, size_t desde = 0) {
+    for (size_t i = desde; i + patron.size() <= texto.size(); ++i) {
+        size_t k = 0;
+        while (k < patron.size() && minusculaEmbebida(texto[i + k]) == patron[k]) ++k;
+        if (k == patron.size()) return i;
+    }
+    return std::string_view::npos;
+}
+
+constexpr bool empiezaEmbebida(std::string_view texto, std::string_view prefijo) {
+    return buscarEmbebida(texto.substr(0, prefijo.size()), prefijo) == 0;
+}
+
+// Entero sin signo de ancho fijo con lo justo para redondear un decimal en constexpr: los
+// operandos son a lo sumo una mantisa de 19 cifras por 10^327, desplazada unos 60 bits
+struct EnteroGrandeEmbebida {
+    static constexpr int kPalabras = 48;
+    std::array<uint32_t, kPalabras> palabra{};
+
+    constexpr explicit EnteroGrandeEmbebida(uint64_t valor = 0) {
+        palabra[0] = static_cast<uint32_t>(valor);
+        palabra[1] = static_cast<uint32_t>(valor >> 32);
+    }
+    constexpr int longitud() const {
+        for (int i = kPalabras - 1; i >= 0; --i) {
+            for (int b = 31; palabra[i] && b >= 0; --b) {
+                if (palabra[i] >> b) return 32 * i + b + 1;
+            }
+        }
+        return 0;
+    }
+    constexpr bool bit(int i) const {
+        return i >= 0 && (palabra[i / 32] >> (i % 32)) & 1;
+    }
+    constexpr void activar(int i) {
+        palabra[i / 32] |= 1u << (i % 32);
+    }
+    constexpr void multiplicar(uint32_t factor) {
+        uint64_t acarreo = 0;
+        for (auto& p : palabra) {
+            uint64_t t = static_cast<uint64_t>(p) * factor + acarreo;
+            p = static_cast<uint32_t>(t);
+            acarreo = t >> 32;
+        }
+        if (acarreo) errorBcEmbebida("número fuera de rango");
+    }
+    constexpr void desplazar(int bits) { // A la izquierda
+        if (longitud() + bits > 32 * kPalabras) errorBcEmbebida("número fuera de rango");
+        int palabras = bits / 32, resto = bits % 32;
+        for (int i = kPalabras - 1; i >= 0; --i) {
+            uint64_t alta = i - palabras >= 0 ? palabra[i - palabras] : 0;
+            uint64_t baja = i - palabras - 1 >= 0 ? palabra[i - palabras - 1] : 0;
+            palabra[i] = static_cast<uint32_t>((alta << resto) | (resto ? baja >> (32 - resto) : 0));
+        }
+    }
+    constexpr bool mayorOIgual(const EnteroGrandeEmbebida& otro) const {
+        for (int i = kPalabras - 1; i >= 0; --i) {
+            if (palabra[i] != otro.palabra[i]) return palabra[i] > otro.palabra[i];
+        }
+        return true;
+    }
+    constexpr void restar(const EnteroGrandeEmbebida& otro) {
+        int64_t prestado = 0;
+        for (int i = 0; i < kPalabras; ++i) {
+            int64_t t = static_cast<int64_t>(palabra[i]) - otro.palabra[i] - prestado;
+            prestado = t < 0;
+            palabra[i] = static_cast<uint32_t>(t + (prestado << 32));
+        }
+    }
+};
+
+// mantisa * 10^escala redondeado al double más cercano (empates al par), como std::stod.
+// Se divide mantisa * 10^escala * 2^k entre 10^-escala con k suficiente para que el cociente
+// tenga al menos 55 bits; el bit siguiente al 53 y el resto deciden el redondeo. Los
+// resultados subnormales o infinitos son un error.
+constexpr double redondearDecimalEmbebida(uint64_t mantisa, int escala) {
+    EnteroGrandeEmbebida numerador(mantisa), divisor(1);
+    for (int e = 0; e < escala; ++e) numerador.multiplicar(10);
+    for (int e = 0; e < -escala; ++e) divisor.multiplicar(10);
+    int k = std::max(0, 55 + divisor.longitud() - numerador.longitud());
+    numerador.desplazar(k);
+
+    EnteroGrandeEmbebida cociente, resto;
+    bool restoCero = true;
+    if (escala >= 0) {
+        cociente = numerador;
+    } else {
+        for (int b = numerador.longitud() - 1; b >= 0; --b) {
+            resto.desplazar(1);
+            if (numerador.bit(b)) resto.activar(0);
+            if (resto.mayorOIgual(divisor)) {
+                resto.restar(divisor);
+                cociente.activar(b);
+            }
+        }
+        restoCero = resto.longitud() == 0;
+    }
+
+    int descartados = cociente.longitud() - 53;
+    uint64_t significando = 0;
+    for (int b = cociente.longitud() - 1; b >= descartados; --b) significando = (significando << 1) | cociente.bit(b);
+    bool pegajoso = !restoCero;
+    for (int b = 0; b < descartados - 1 && !pegajoso; ++b) pegajoso = cociente.bit(b);
+    if (cociente.bit(descartados - 1) && (pegajoso || (significando & 1))) {
+        if (++significando == (uint64_t(1) << 53)) {
+            significando >>= 1;
+            ++descartados;
+        }
+    }
+    int exponente = descartados - k; // valor = significando * 2^exponente
+    if (52 + exponente > 1023 || 52 + exponente < -1022) errorBcEmbebida("número fuera del rango normal de double");
+    double valor = static_cast<double>(significando);
+    for (int e = 0; e < exponente; ++e) valor *= 2.0;
+    for (int e = 0; e < -exponente; ++e) valor *= 0.5;
+    return valor;
+}
+
+// Decimal con signo, parte fraccionaria y exponente opcionales, con hasta 19 cifras
+// significativas (los ceros a la izquierda y a la derecha no cuentan)
+constexpr double leerNumeroEmbebida(std::string_view texto) {
+    size_t i = 0;
+    bool negativo = false;
+    if (i < texto.size() && (texto[i] == '+' || texto[i] == '-')) negativo = texto[i++] == '-';
+    uint64_t mantisa = 0;
+    int cifras = 0, significativas = 0, cerosPendientes = 0, escala = 0;
+    for (bool fraccion = false; i < texto.size(); ++i) {
+        if (texto[i] == '.' && !fraccion) {
+            fraccion = true;
+            continue;
+        }
+        if (texto[i] < '0' || texto[i] > '9') break;
+        ++cifras;
+        if (fraccion) --escala;
+        if (texto[i] == '0') {
+            if (significativas > 0) ++cerosPendientes; // Sólo se añaden si les sigue otra cifra
+            continue;
+        }
+        significativas += cerosPendientes + 1;
+        if (significativas > 19) errorBcEmbebida("número con más de 19 cifras significativas");
+        for (; cerosPendientes > 0; --cerosPendientes) mantisa *= 10;
+        mantisa = mantisa * 10 + static_cast<uint64_t>(texto[i] - '0');
+    }
+    escala += cerosPendientes;
+    if (cifras == 0) errorBcEmbebida("se esperaba un número");
+    if (i < texto.size() && minusculaEmbebida(texto[i]) == 'e') {
+        bool expNegativo = false;
+        ++i;
+        if (i < texto.size() && (texto[i] == '+' || texto[i] == '-')) expNegativo = texto[i++] == '-';
+        int exponente = 0;
+        if (i == texto.size()) errorBcEmbebida("exponente vacío");
+        for (; i < texto.size() && texto[i] >= '0' && texto[i] <= '9'; ++i) exponente = std::min(exponente * 10 + (texto[i] - '0'), 1000);
+        escala += expNegativo ? -exponente : exponente;
+    }
+    if (i != texto.size()) errorBcEmbebida("número mal formado");
+    if (mantisa == 0) return negativo ? -0.0 : 0.0;
+    int magnitud = significativas - 1 + escala; // Exponente decimal de la primera cifra
+    if (magnitud > 308 || magnitud < -308) errorBcEmbebida("número fuera del rango normal de double");
+    double valor = redondearDecimalEmbebida(mantisa, escala);
+    return negativo ? -valor : valor;
+}
+
+constexpr int leerEnteroEmbebida(std::string_view texto) {
+    double valor = leerNumeroEmbebida(texto);
+    if (valor != static_cast<double>(static_cast<long long>(valor)) || valor > 2147483647.0 || valor < -2147483648.0) {
+        errorBcEmbebida("se esperaba un entero");
+    }
+    return static_cast<int>(valor);
+}
+
+constexpr std::string_view nombreEmbebida(std::string_view texto) {
+    texto = recortarEmbebida(texto);
+    if (texto.empty()) errorBcEmbebida("literal vacío");
+    for (char c : texto) {
+        if (c == '(' || c == ')' || c == '{' || c == '}' || c == '<' || c == '>' || c == '=' || c == ',' || c == ':') {
+            errorBcEmbebida("sólo se admiten símbolos proposicionales (sin comparaciones, argumentos ni plantillas)");
+        }
+    }
+    return texto;
+}
+
+struct ReglaEmbebida {
+    std::string_view id;
+    OperadorLogico operador = OperadorLogico::NINGUNO;
+    int consecuente = -1;
+    double factorCertezaRegla = 0.0;
+    int prioridad = 0;
+    int inicioCondiciones = 0, finCondiciones = 0;
+};
+
+// Tablas de la BC: reglas en orden de fichero, condiciones como ids de símbolo y, por cada
+// símbolo, las reglas que lo concluyen (CSR). Los nombres apuntan al literal original.
+template <size_t NR, size_t NC>
+struct BaseEmbebida {
+    static constexpr size_t kMaxSimbolos = NR + NC; // Cota: cada símbolo aparece en alguna regla
+    std::array<ReglaEmbebida, NR> reglas{};
+    std::array<int, NC> condiciones{};
+    std::array<std::string_view, kMaxSimbolos> simbolos{};
+    std::array<int, kMaxSimbolos + 1> inicioReglasDe{};
+    std::array<int, NR> reglasDe{};
+    std::array<uint8_t, kMaxSimbolos> saturable{}; // Como en BaseCompilada
+    size_t numReglas = 0, numCondiciones = 0, numSimbolos = 0;
+
+    constexpr int simbolo(std::string_view nombre) const {
+        for (size_t s = 0; s < numSimbolos; ++s) {
+            if (simbolos[s] == nombre) return static_cast<int>(s);
+        }
+        return -1;
+    }
+
+    constexpr std::array<double, kMaxSimbolos> sinHechos() const {
+        std::array<double, kMaxSimbolos> hechos{};
+        for (auto& fc : hechos) fc = std::numeric_limits<double>::quiet_NaN();
+        return hechos;
+    }
+
+    // Destino de recorrerBcEmbebida
+    constexpr int internar(std::string_view nombre) {
+        int s = simbolo(nombre);
+        if (s >= 0) return s;
+        simbolos[numSimbolos] = nombre;
+        return static_cast<int>(numSimbolos++);
+    }
+    constexpr void condicion(std::string_view nombre) {
+        condiciones[numCondiciones++] = internar(nombre);
+    }
+    constexpr void regla(std::string_view id, OperadorLogico operador, std::string_view consecuente, double fc, int prioridad) {
+        ReglaEmbebida& r = reglas[numReglas++];
+        r.id = id;
+        r.operador = operador;
+        r.consecuente = internar(consecuente);
+        r.factorCertezaRegla = fc;
+        r.prioridad = prioridad;
+        r.inicioCondiciones = numReglas > 1 ? reglas[numReglas - 2].finCondiciones : 0;
+        r.finCondiciones = static_cast<int>(numCondiciones);
+    }
+};
+
+// Sólo cuenta reglas y condiciones, para dimensionar BaseEmbebida
+struct MedidaEmbebida {
+    size_t reglas = 0, condiciones = 0;
+    constexpr void condicion(std::string_view) { ++condiciones; }
+    constexpr void regla(std::string_view, OperadorLogico, std::string_view, double, int) { ++reglas; }
+};
+
+// Parsea el literal llamando a destino.condicion() por cada condición y después a
+// destino.regla() por cada regla, en orden de fichero
+template <typename Destino>
+constexpr void recorrerBcEmbebida(std::string_view texto, Destino& destino) {
+    auto siguienteLinea = [&texto]() {
+        size_t fin = texto.find('\n');
+        std::string_view linea = texto.substr(0, fin);
+        texto.remove_prefix(fin == std::string_view::npos ? texto.size() : fin + 1);
+        return recortarEmbebida(linea);
+    };
+    if (texto.empty()) errorBcEmbebida("BC vacía");
+    int numReglas = leerEnteroEmbebida(siguienteLinea());
+    for (int i = 0; i < numReglas;) {
+        if (texto.empty()) errorBcEmbebida("faltan reglas: la cabecera declara más de las que hay");
+        std::string_view linea = siguienteLinea();
+        if (linea.empty()) continue;
+        ++i;
+        size_t dosPuntos = linea.find(':');
+        if (dosPuntos == std::string_view::npos) errorBcEmbebida("falta ':' tras el id de la regla");
+        std::string_view id = recortarEmbebida(linea.substr(0, dosPuntos));
+        if (id.find('[') != std::string_view::npos) errorBcEmbebida("las plantillas no se admiten en una BC embebida");
+        std::string_view definicion = recortarEmbebida(linea.substr(dosPuntos + 1));
+
+        // ", FC=x" y ", prioridad=n" opcional al final
+        int prioridad = 0;
+        size_t coma = definicion.rfind(',');
+        if (coma == std::string_view::npos) errorBcEmbebida("falta ', FC=' en la regla");
+        std::string_view cola = recortarEmbebida(definicion.substr(coma + 1));
+        if (empiezaEmbebida(cola, "prioridad")) {
+            cola = recortarEmbebida(cola.substr(9));
+            if (cola.empty() || cola.front() != '=') errorBcEmbebida("falta '=' tras 'prioridad'");
+            prioridad = leerEnteroEmbebida(recortarEmbebida(cola.substr(1)));
+            definicion = recortarEmbebida(definicion.substr(0, coma));
+            coma = definicion.rfind(',');
+            if (coma == std::string_view::npos) errorBcEmbebida("falta ', FC=' en la regla");
+            cola = recortarEmbebida(definicion.substr(coma + 1));
+        }
+        if (!empiezaEmbebida(cola, "fc")) errorBcEmbebida("falta ', FC=' en la regla");
+        cola = recortarEmbebida(cola.substr(2));
+        if (cola.empty() || cola.front() != '=') errorBcEmbebida("falta '=' tras 'FC'");
+        double fc = leerNumeroEmbebida(recortarEmbebida(cola.substr(1)));
+
+        // "Si alfa Entonces beta"
+        std::string_view siEntonces = recortarEmbebida(definicion.substr(0, coma));
+        if (!empiezaEmbebida(siEntonces, "si ")) errorBcEmbebida("la regla no empieza por 'Si'");
+        size_t entonces = buscarEmbebida(siEntonces, " entonces ", 3);
+        if (entonces == std::string_view::npos) errorBcEmbebida("falta 'Entonces' en la regla");
+        std::string_view alfa = siEntonces.substr(3, entonces - 3);
+        std::string_view beta = siEntonces.substr(entonces + 10);
+
+        bool hayY = buscarEmbebida(alfa, " y ") != std::string_view::npos;
+        bool hayO = buscarEmbebida(alfa, " o ") != std::string_view::npos;
+        if (hayY && hayO) errorBcEmbebida("no se pueden mezclar 'y' y 'o' en un antecedente");
+        OperadorLogico operador = hayY ? OperadorLogico::Y : hayO ? OperadorLogico::O : OperadorLogico::NINGUNO;
+        std::string_view separador = hayY ? " y " : " o ";
+        for (size_t inicio = 0;;) {
+            size_t fin = operador == OperadorLogico::NINGUNO ? std::string_view::npos : buscarEmbebida(alfa, separador, inicio);
+            destino.condicion(nombreEmbebida(alfa.substr(inicio, fin == std::string_view::npos ? alfa.size() - inicio : fin - inicio)));
+            if (fin == std::string_view::npos) break;
+            inicio = fin + separador.size();
+        }
+        destino.regla(id, operador, nombreEmbebida(beta), fc, prioridad);
+    }
+}
+
+template <size_t NR, size_t NC>
+constexpr BaseEmbebida<NR, NC> compilarBcEmbebida(std::string_view texto) {
+    BaseEmbebida<NR, NC> base;
+    recorrerBcEmbebida(texto, base);
+    for (size_t s = 0; s < base.numSimbolos; ++s) base.saturable[s] = 3;
+    for (size_t r = 0; r < base.numReglas; ++r) {
+        const ReglaEmbebida& regla = base.reglas[r];
+        base.inicioReglasDe[regla.consecuente + 1]++;
+        if (regla.factorCertezaRegla <= -1.0) base.saturable[regla.consecuente] &= ~1;
+        if (regla.factorCertezaRegla >= 1.0) base.saturable[regla.consecuente] &= ~2;
+    }
+    for (size_t s = 0; s < base.numSimbolos; ++s) base.inicioReglasDe[s + 1] += base.inicioReglasDe[s];
+    std::array<int, BaseEmbebida<NR, NC>::kMaxSimbolos + 1> libre = base.inicioReglasDe;
+    for (size_t r = 0; r < base.numReglas; ++r) base.reglasDe[libre[base.reglas[r].consecuente]++] = static_cast<int>(r);
+    return base;
+}
+
+constexpr MedidaEmbebida medirBcEmbebida(std::string_view texto) {
+    MedidaEmbebida medida;
+    recorrerBcEmbebida(texto, medida);
+    return medida;
+}
+
+// La BC del literal `texto`, que debe ser un array constexpr con enlace estático
+template <const char* texto>
+struct CompilacionEmbebida {
+    static constexpr MedidaEmbebida medida = medirBcEmbebida(texto);
+    static constexpr BaseEmbebida<medida.reglas, medida.condiciones> base =
+        compilarBcEmbebida<medida.reglas, medida.condiciones>(texto);
+};
+
+template <const char* texto>
+constexpr const auto& bcEmbebida = CompilacionEmbebida<texto>::base;
+
+// Motor hacia atrás sobre las tablas, con la misma semántica que evaluarSimbolo (ciclos sin
+// evidencia, antecedentes con cortocircuito, aportaciones en orden de fichero, saturación).
+// Todo el estado está en la pila.
+template <typename Calculo, size_t NR, size_t NC>
+struct EvaluacionEmbebida {
+    static constexpr size_t kMaxSimbolos = BaseEmbebida<NR, NC>::kMaxSimbolos;
+    const BaseEmbebida<NR, NC>& base;
+    const std::array<double, kMaxSimbolos>& hechos;
+    std::array<double, kMaxSimbolos> fc{};
+    std::array<EstadoSimbolo, kMaxSimbolos> estado{};
+
+    constexpr double evaluar(int s) {
+        if (estado[s] != EstadoSimbolo::DESCONOCIDO) return estado[s] == EstadoSimbolo::CONOCIDO ? fc[s] : 0.0;
+        if (hechos[s] == hechos[s]) { // Hecho inicial (no NaN)
+            estado[s] = EstadoSimbolo::CONOCIDO;
+            return fc[s] = hechos[s];
+        }
+        estado[s] = EstadoSimbolo::EN_CURSO;
+        double resultado = 0.0;
+        bool primera = true;
+        for (int k = base.inicioReglasDe[s]; k < base.inicioReglasDe[s + 1]; ++k) {
+            const ReglaEmbebida& regla = base.reglas[base.reglasDe[k]];
+            bool esO = regla.operador == OperadorLogico::O;
+            double antecedente = 0.0;
+            for (int c = regla.inicioCondiciones; c < regla.finCondiciones; ++c) {
+                double valor = evaluar(base.condiciones[c]);
+                antecedente = c == regla.inicioCondiciones ? valor : (esO ? Calculo::o(antecedente, valor) : Calculo::y(antecedente, valor));
+                if (esO ? valor >= 1.0 : valor <= 0.0) break;
+            }
+            if (antecedente <= 0.0) continue;
+            double aportacion = Calculo::encadenar(regla.factorCertezaRegla, antecedente);
+            resultado = primera ? aportacion : Calculo::combinar(resultado, aportacion);
+            primera = false;
+            if (Calculo::satura(aportacion, base.saturable[s])) break;
+        }
+        estado[s] = EstadoSimbolo::CONOCIDO;
+        return fc[s] = resultado;
+    }
+};
+
+template <typename Calculo = CalculoMycin, size_t NR, size_t NC>
+constexpr double evaluarEmbebida(const BaseEmbebida<NR, NC>& base, const std::array<double, NR + NC>& hechos, int objetivo) {
+    if (objetivo < 0) return 0.0;
+    EvaluacionEmbebida<Calculo, NR, NC> evaluacion{base, hechos};
+    return evaluacion.evaluar(objetivo);
+}
+
+// Prueba-1 resuelta al compilar
+constexpr double fcPrueba1Embebida() {
+    const auto& bc = bcEmbebida<kReglasPrueba1>;
+    auto hechos = bc.sinHechos();
+    hechos[bc.simbolo("h2")] = 0.3;
+    hechos[bc.simbolo("h4")] = 0.6;
+    hechos[bc.simbolo("h5")] = 0.6;
+    hechos[bc.simbolo("h6")] = 0.9;
+    hechos[bc.simbolo("h7")] = 0.5;
+    return evaluarEmbebida(bc, hechos, bc.simbolo("h1"));
+}
+static_assert(fcPrueba1Embebida() > kResultadoPrueba1 - 1e-12 && fcPrueba1Embebida() < kResultadoPrueba1 + 1e-12,
+              "La BC embebida de Prueba-1 debe dar h1 = 0.66");
+
+
+
+// --- Reglas de Primer Orden ---
+
+// Una regla con variables ("R1: Si fiebre(X) y tos(X) Entonces gripe(X), FC=0.8") no se
+// instancia al cargar la BC: en cada consulta se generan sólo las instancias que pueden
+// contribuir al objetivo, partiendo de él hacia atrás. Una variable de una condición que no
+// está en el consecuente se liga recorriendo los átomos básicos que pueden ser conocidos en
+// la consulta (hechos de la BH, consecuentes de reglas sin variables y consecuentes de
+// instancias ya generadas), que se buscan en árboles de discriminación. Después la BC
+// instanciada se compila y se resuelve con el motor de siempre.
+//
+// Restricciones: toda variable del consecuente aparece en el antecedente; en una regla con
+// "o", además, todas las variables aparecen en el consecuente y en cada condición. Los hechos
+// de la BH son básicos. Los átomos no admiten términos anidados.
+
+static std::string clavePredicado(const Atomo& a) {
+    return a.predicado + "/" + std::to_string(a.argumentos.size());
+}
+
+// Árbol de discriminación de átomos básicos: el primer nivel distingue "predicado/aridad" y
+// cada nivel siguiente un argumento. Buscar un patrón con variables recorre todos los hijos
+// en las posiciones libres y un solo hijo en las ligadas. Cada nodo cuenta los átomos que
+// cuelgan de él, lo que da una estimación barata del número de candidatos para ordenar joins.
+class ArbolDiscriminacion {
+public:
+    ArbolDiscriminacion() : nodos(1) {}
+
+    // Devuelve false si el átomo ya estaba
+    bool insertar(const Atomo& a) {
+        std::vector<int> camino(1, 0);
+        camino.push_back(hijo(0, clavePredicado(a)));
+        for (const auto& arg : a.argumentos) camino.push_back(hijo(camino.back(), arg));
+        Nodo& hoja = nodos[camino.back()];
+        if (hoja.atomo >= 0) return false;
+        hoja.atomo = static_cast<int>(atomos.size());
+        atomos.push_back(a);
+        for (int n : camino) nodos[n].cuenta++;
+        return true;
+    }
+    void buscar(const Atomo& patron, std::vector<const Atomo*>& encontrados) const {
+        auto it = nodos[0].hijos.find(clavePredicado(patron));
+        if (it != nodos[0].hijos.end()) recorrer(it->second, patron, 0, encontrados);
+    }
+    // Átomos bajo el nodo al que se llega siguiendo los argumentos ligados iniciales
+    size_t estimar(const Atomo& patron) const {
+        auto it = nodos[0].hijos.find(clavePredicado(patron));
+        if (it == nodos[0].hijos.end()) return 0;
+        int n = it->second;
+        for (const auto& arg : patron.argumentos) {
+            if (esVariable(arg)) break;
+            auto h = nodos[n].hijos.find(arg);
+            if (h == nodos[n].hijos.end()) return 0;
+            n = h->second;
+        }
+        return nodos[n].cuenta;
+    }
+private:
+    struct Nodo {
+        std::map<std::string, int> hijos; // Ordenados: la enumeración es determinista
+        size_t cuenta = 0;
+        int atomo = -1;
+    };
+    int hijo(int n, const std::string& clave) {
+        auto it = nodos[n].hijos.find(clave);
+        if (it != nodos[n].hijos.end()) return it->second;
+        int nuevo = static_cast<int>(nodos.size());
+        nodos[n].hijos.emplace(clave, nuevo);
+        nodos.emplace_back();
+        return nuevo;
+    }
+    void recorrer(int n, const Atomo& patron, size_t i, std::vector<const Atomo*>& encontrados) const {
+        if (i == patron.argumentos.size()) {
+            encontrados.push_back(&atomos[nodos[n].atomo]);
+            return;
+        }
+        if (esVariable(patron.argumentos[i])) {
+            for (const auto& h : nodos[n].hijos) recorrer(h.second, patron, i + 1, encontrados);
+        } else {
+            auto h = nodos[n].hijos.find(patron.argumentos[i]);
+            if (h != nodos[n].hijos.end()) recorrer(h->second, patron, i + 1, encontrados);
+        }
+    }
+    std::vector<Nodo> nodos;
+    std::deque<Atomo> atomos; // Direcciones estables para los punteros devueltos por buscar
+};
+
+typedef std::map<std::string, std::string> Ligaduras; // Variable -> constante
+
+// Unifica un patrón con un átomo básico ampliando las ligaduras
+static bool unificar(const Atomo& patron, const Atomo& basico, Ligaduras& ligaduras) {
+    if (patron.predicado != basico.predicado || patron.argumentos.size() != basico.argumentos.size()) return false;
+    for (size_t i = 0; i < patron.argumentos.size(); ++i) {
+        const std::string& t = patron.argumentos[i];
+        if (!esVariable(t)) {
+            if (t != basico.argumentos[i]) return false;
+            continue;
+        }
+        auto it = ligaduras.emplace(t, basico.argumentos[i]).first;
+        if (it->second != basico.argumentos[i]) return false;
+    }
+    return true;
+}
+
+// Como unificar, pero las variables del patrón (de otra regla) son comodines
+static bool unificarCabeza(const Atomo& cabeza, const Atomo& patron, Ligaduras& ligaduras) {
+    if (cabeza.predicado != patron.predicado || cabeza.argumentos.size() != patron.argumentos.size()) return false;
+    for (size_t i = 0; i < cabeza.argumentos.size(); ++i) {
+        const std::string& p = patron.argumentos[i];
+        if (esVariable(p)) continue;
+        const std::string& t = cabeza.argumentos[i];
+        if (!esVariable(t)) {
+            if (t != p) return false;
+            continue;
+        }
+        auto it = ligaduras.emplace(t, p).first;
+        if (it->second != p) return false;
+    }
+    return true;
+}
+
+static Atomo sustituir(const Atomo& a, const Ligaduras& ligaduras) {
+    Atomo res = a;
+    for (auto& t : res.argumentos) {
+        if (!esVariable(t)) continue;
+        auto it = ligaduras.find(t);
+        if (it != ligaduras.end()) t = it->second;
+    }
+    return res;
+}
+
+static int variablesLibres(const Atomo& a) {
+    return static_cast<int>(std::count_if(a.argumentos.begin(), a.argumentos.end(), esVariable));
+}
+
+// BC preparada para instanciar por consulta
+struct BasePrimerOrden {
+    BaseConocimiento bc;
+    std::vector<bool> conVariables;                  // Por regla
+    std::vector<Atomo> consecuentes;
+    std::vector<std::vector<Atomo>> condiciones;
+    std::vector<std::vector<std::string>> variables; // De cada regla, en orden de aparición
+    std::unordered_map<std::string, std::vector<int>> reglasBasicasDe;     // Átomo -> reglas sin variables
+    std::unordered_map<std::string, std::vector<int>> reglasConVariablesDe; // "predicado/aridad" -> reglas
+    ArbolDiscriminacion cabezasBasicas; // Consecuentes de las reglas sin variables
+};
+
+bool tieneVariables(const BaseConocimiento& bc) {
+    for (const auto& regla : bc.reglas) {
+        if (variablesLibres(parsearAtomo(regla.consecuente.nombre)) > 0) return true;
+        for (const auto& c : regla.antecedente.condiciones) {
+            if (variablesLibres(parsearAtomo(c.nombre)) > 0) return true;
+        }
+    }
+    return false;
+}
+
+bool construirBasePrimerOrden(const BaseConocimiento& bc, BasePrimerOrden& bpo) {
+    bpo.bc = bc;
+    for (size_t r = 0; r < bc.reglas.size(); ++r) {
+        const Regla& regla = bc.reglas[r];
+        Atomo cabeza = parsearAtomo(regla.consecuente.nombre);
+        std::vector<Atomo> conds;
+        std::vector<std::string> vars;
+        auto anotar = [&](const Atomo& a) {
+            for (const auto& t : a.argumentos) {
+                if (esVariable(t) && std::find(vars.begin(), vars.end(), t) == vars.end()) vars.push_back(t);
+            }
+        };
+        anotar(cabeza);
+        for (const auto& c : regla.antecedente.condiciones) {
+            conds.push_back(parsearAtomo(c.nombre));
+            anotar(conds.back());
+        }
+        for (const auto& v : vars) {
+            bool enAntecedente = false, enTodas = true;
+            for (const auto& c : conds) {
+                bool esta = std::find(c.argumentos.begin(), c.argumentos.end(), v) != c.argumentos.end();
+                enAntecedente = enAntecedente || esta;
+                enTodas = enTodas && esta;
+            }
+            bool enCabeza = std::find(cabeza.argumentos.begin(), cabeza.argumentos.end(), v) != cabeza.argumentos.end();
+            if (!enAntecedente) {
+                std::cerr << "Error: La variable " << v << " del consecuente no aparece en el antecedente de " << regla.id << std::endl;
+                return false;
+            }
+            if (regla.antecedente.operador == OperadorLogico::O && (!enTodas || !enCabeza)) {
+                std::cerr << "Error: En una regla con 'o' cada variable debe aparecer en el consecuente y en todas las condiciones: "
+                          << regla.id << std::endl;
+                return false;
+            }
+        }
+        bpo.conVariables.push_back(!vars.empty());
+        if (vars.empty()) {
+            bpo.reglasBasicasDe[regla.consecuente.nombre].push_back(static_cast<int>(r));
+            bpo.cabezasBasicas.insertar(cabeza);
+        } else {
+            bpo.reglasConVariablesDe[clavePredicado(cabeza)].push_back(static_cast<int>(r));
+        }
+        bpo.consecuentes.push_back(cabeza);
+        bpo.condiciones.push_back(conds);
+        bpo.variables.push_back(vars);
+    }
+    return true;
+}
+
+// Instanciación de la BC para una consulta. expandir() recorre hacia atrás desde un átomo
+// básico; candidatos() enumera los átomos básicos que pueden casar con un patrón, generando
+// antes (una vez por patrón) las instancias de las reglas cuyo consecuente casa con él.
+// Con reglas recursivas un patrón o un átomo puede pedirse mientras se está calculando; en
+// ese caso la pasada se marca incompleta y se repite hasta que no aparecen instancias nuevas.
+class InstanciadorConsulta {
+public:
+    InstanciadorConsulta(const BasePrimerOrden& bpo, const BaseHechos& bh) : bpo(bpo), bh(bh), instancias(bpo.bc.reglas.size()) {
+        for (const auto& par : bh.fc_memoria) hechos.insertar(parsearAtomo(par.first));
+    }
+
+    BaseConocimiento instanciar(const std::string& objetivo) {
+        Atomo meta = parsearAtomo(objetivo);
+        do {
+            incompleto = false;
+            nuevas = 0;
+            expandidos.clear();
+            patronesGenerados.clear();
+            expandir(meta);
+        } while (incompleto && nuevas > 0);
+
+        // Reglas sin variables alcanzadas e instancias, en el orden de sus reglas en el fichero;
+        // las instancias de una misma regla, ordenadas por los valores de sus variables
+        BaseConocimiento bc;
+        for (size_t r = 0; r < bpo.bc.reglas.size(); ++r) {
+            if (!bpo.conVariables[r]) {
+                if (expandidos.count(bpo.bc.reglas[r].consecuente.nombre)) bc.reglas.push_back(bpo.bc.reglas[r]);
+                continue;
+            }
+            std::sort(instancias[r].begin(), instancias[r].end(),
+                      [](const Instancia& a, const Instancia& b) { return a.valores < b.valores; });
+            for (auto& inst : instancias[r]) bc.reglas.push_back(std::move(inst.regla));
+        }
+        return bc;
+    }
+
+private:
+    enum class Expansion : uint8_t { EN_CURSO, SOPORTADO, SIN_SOPORTE };
+    struct Instancia {
+        std::vector<std::string> valores;
+        Regla regla;
+    };
+
+    // Genera lo necesario para un átomo básico. Devuelve si puede tener un FC distinto de 0.
+    bool expandir(const Atomo& a) {
+        std::string nombre = nombreAtomo(a);
+        auto emplazado = expandidos.emplace(nombre, Expansion::EN_CURSO);
+        if (!emplazado.second) {
+            if (emplazado.first->second == Expansion::EN_CURSO) incompleto = true;
+            return emplazado.first->second != Expansion::SIN_SOPORTE; // En curso: suponerlo conocido
+        }
+        bool soportado = bh.fc_memoria.count(nombre) > 0;
+        Comparacion comp;
+        if (!soportado && parsearComparacion(nombre, comp)) soportado = bh.valores.count(comp.atributo) > 0;
+        auto basicas = bpo.reglasBasicasDe.find(nombre);
+        if (basicas != bpo.reglasBasicasDe.end()) {
+            soportado = true;
+            for (int r : basicas->second) {
+                for (const auto& c : bpo.condiciones[r]) expandir(c);
+            }
+        }
+        auto conVariables = bpo.reglasConVariablesDe.find(clavePredicado(a));
+        if (conVariables != bpo.reglasConVariablesDe.end()) {
+            for (int r : conVariables->second) {
+                Ligaduras ligaduras;
+                if (unificarCabeza(bpo.consecuentes[r], a, ligaduras) && unirRegla(r, ligaduras)) soportado = true;
+            }
+        }
+        expandidos[nombre] = soportado ? Expansion::SOPORTADO : Expansion::SIN_SOPORTE;
+        return soportado;
+    }
+
+    // Instancias de la regla r compatibles con las ligaduras. Devuelve si hay alguna.
+    bool unirRegla(int r, const Ligaduras& ligaduras) {
+        const auto& conds = bpo.condiciones[r];
+        if (bpo.bc.reglas[r].antecedente.operador != OperadorLogico::O) {
+            std::vector<int> pendientes(conds.size());
+            for (size_t c = 0; c < conds.size(); ++c) pendientes[c] = static_cast<int>(c);
+            return unir(r, ligaduras, pendientes);
+        }
+        // "o": cada condición contiene todas las variables y basta una con soporte
+        bool alguna = false;
+        if (ligaduras.size() == bpo.variables[r].size()) {
+            for (const auto& c : conds) alguna = expandir(sustituir(c, ligaduras)) || alguna;
+            if (alguna) crearInstancia(r, ligaduras);
+            return alguna;
+        }
+        for (const auto& c : conds) {
+            for (const auto& candidato : candidatos(sustituir(c, ligaduras))) {
+                Ligaduras ampliadas = ligaduras;
+                if (!unificar(c, candidato, ampliadas)) continue;
+                for (const auto& otra : conds) expandir(sustituir(otra, ampliadas));
+                crearInstancia(r, ampliadas);
+                alguna = true;
+            }
+        }
+        return alguna;
+    }
+
+    // Join de las condiciones pendientes de una regla "y". En cada paso se liga primero la
+    // condición más selectiva: las básicas (una comprobación) y después la de menos candidatos
+    // estimados según los árboles de discriminación.
+    bool unir(int r, const Ligaduras& ligaduras, std::vector<int> pendientes) {
+        if (pendientes.empty()) {
+            crearInstancia(r, ligaduras);
+            return true;
+        }
+        size_t mejor = 0;
+        std::pair<int, size_t> costeMejor(INT32_MAX, 0);
+        for (size_t i = 0; i < pendientes.size(); ++i) {
+            Atomo p = sustituir(bpo.condiciones[r][pendientes[i]], ligaduras);
+            int libres = variablesLibres(p);
+            std::pair<int, size_t> coste(libres > 0 ? 1 : 0, libres > 0 ? estimar(p) : 0);
+            if (coste < costeMejor) {
+                costeMejor = coste;
+                mejor = i;
+            }
+        }
+        const Atomo& condicion = bpo.condiciones[r][pendientes[mejor]];
+        Atomo patron = sustituir(condicion, ligaduras);
+        pendientes.erase(pendientes.begin() + mejor);
+        if (variablesLibres(patron) == 0) {
+            // Sin soporte vale 0 y anula la conjunción: no hay instancias por este camino
+            return expandir(patron) && unir(r, ligaduras, pendientes);
+        }
+        bool alguna = false;
+        for (const auto& candidato : candidatos(patron)) {
+            Ligaduras ampliadas = ligaduras;
+            if (!unificar(condicion, candidato, ampliadas) || !expandir(candidato)) continue;
+            alguna = unir(r, ampliadas, pendientes) || alguna;
+        }
+        return alguna;
+    }
+
+    size_t estimar(const Atomo& patron) const {
+        size_t n = hechos.estimar(patron) + bpo.cabezasBasicas.estimar(patron) + derivados.estimar(patron);
+        if (bpo.reglasConVariablesDe.count(clavePredicado(patron))) n += 1000; // Aún por derivar
+        return n;
+    }
+
+    std::vector<Atomo> candidatos(const Atomo& patron) {
+        std::string clave = patron.predicado + "/";
+        for (const auto& t : patron.argumentos) clave += (esVariable(t) ? std::string("?") : t) + ",";
+        auto emplazado = patronesGenerados.emplace(clave, true);
+        if (emplazado.second) {
+            auto conVariables = bpo.reglasConVariablesDe.find(clavePredicado(patron));
+            if (conVariables != bpo.reglasConVariablesDe.end()) {
+                for (int r : conVariables->second) {
+                    Ligaduras ligaduras;
+                    if (unificarCabeza(bpo.consecuentes[r], patron, ligaduras)) unirRegla(r, ligaduras);
+                }
+            }
+            patronesGenerados[clave] = false;
+        } else if (emplazado.first->second) {
+            incompleto = true; // Patrón en curso: sus candidatos aún pueden crecer
+        }
+        std::vector<const Atomo*> encontrados;
+        hechos.buscar(patron, encontrados);
+        bpo.cabezasBasicas.buscar(patron, encontrados);
+        derivados.buscar(patron, encontrados);
+        std::vector<Atomo> res;
+        std::unordered_map<std::string, bool> vistos;
+        for (const Atomo* a : encontrados) {
+            if (vistos.emplace(nombreAtomo(*a), true).second) res.push_back(*a);
+        }
+        return res;
+    }
+
+    void crearInstancia(int r, const Ligaduras& ligaduras) {
+        Instancia inst;
+        for (const auto& v : bpo.variables[r]) inst.valores.push_back(ligaduras.at(v));
+        std::string clave = std::to_string(r);
+        for (const auto& v : inst.valores) clave += "\x1f" + v;
+        if (!creadas.emplace(clave, true).second) return;
+        const Regla& regla = bpo.bc.reglas[r];
+        inst.regla.id = regla.id + "{";
+        for (size_t i = 0; i < inst.valores.size(); ++i) {
+            inst.regla.id += (i > 0 ? "," : "") + bpo.variables[r][i] + "=" + inst.valores[i];
+        }
+        inst.regla.id += "}";
+        inst.regla.antecedente.operador = regla.antecedente.operador;
+        for (const auto& c : bpo.condiciones[r]) {
+            Hecho h;
+            h.nombre = nombreAtomo(sustituir(c, ligaduras));
+            inst.regla.antecedente.condiciones.push_back(h);
+        }
+        Atomo cabeza = sustituir(bpo.consecuentes[r], ligaduras);
+        inst.regla.consecuente.nombre = nombreAtomo(cabeza);
+        inst.regla.factorCertezaRegla = regla.factorCertezaRegla;
+        inst.regla.prioridad = regla.prioridad;
+        derivados.insertar(cabeza);
+        instancias[r].push_back(std::move(inst));
+        ++nuevas;
+    }
+
+    const BasePrimerOrden& bpo;
+    const BaseHechos& bh;
+    ArbolDiscriminacion hechos;    // Hechos de la BH
+    ArbolDiscriminacion derivados; // Consecuentes de las instancias generadas
+    std::vector<std::vector<Instancia>> instancias; // Por regla del fichero
+    std::unordered_map<std::string, bool> creadas;
+    std::unordered_map<std::string, Expansion> expandidos;
+    std::unordered_map<std::string, bool> patronesGenerados; // true mientras está en curso
+    bool incompleto = false;
+    size_t nuevas = 0;
+};
+
+// Resuelve el objetivo de la BH instanciando la BC de primer orden para esta consulta
+double inferirPrimerOrden(const BasePrimerOrden& bpo, BaseHechos& bh, EstadoInferencia& est) {
+    InstanciadorConsulta instanciador(bpo, bh);
+    BaseConocimiento instanciada = instanciador.instanciar(bh.objetivo.nombre);
+    BaseCompilada bcc = compilarBase(instanciada, OrdenCompilacion::ARCHIVO);
+    return motorDeInferencia(bcc, bh, est);
+}
+
+// Instanciación completa sobre todas las constantes de la BC y la BH. Sólo para comprobar
+// la instanciación por consulta en las pruebas diferenciales: crece exponencialmente.
+BaseConocimiento instanciarCompleta(const BasePrimerOrden& bpo, const BaseHechos& bh) {
+    std::vector<std::string> constantes;
+    auto anotar = [&](const Atomo& a) {
+        for (const auto& t : a.argumentos) {
+            if (!esVariable(t)) constantes.push_back(t);
+        }
+    };
+    for (size_t r = 0; r < bpo.bc.reglas.size(); ++r) {
+        anotar(bpo.consecuentes[r]);
+        for (const auto& c : bpo.condiciones[r]) anotar(c);
+    }
+    for (const auto& par : bh.fc_memoria) anotar(parsearAtomo(par.first));
+    anotar(parsearAtomo(bh.objetivo.nombre));
+    std::sort(constantes.begin(), constantes.end());
+    constantes.erase(std::unique(constantes.begin(), constantes.end()), constantes.end());
+
+    BaseConocimiento bc;
+    for (size_t r = 0; r < bpo.bc.reglas.size(); ++r) {
+        const Regla& regla = bpo.bc.reglas[r];
+        const auto& vars = bpo.variables[r];
+        if (vars.empty()) {
+            bc.reglas.push_back(regla);
+            continue;
+        }
+        if (constantes.empty()) continue;
+        // Todas las asignaciones en orden lexicográfico de valores, como InstanciadorConsulta
+        std::vector<size_t> indice(vars.size(), 0);
+        while (true) {
+            Ligaduras ligaduras;
+            for (size_t i = 0; i < vars.size(); ++i) ligaduras[vars[i]] = constantes[indice[i]];
+            Regla inst;
+            inst.id = regla.id;
+            inst.antecedente.operador = regla.antecedente.operador;
+            for (const auto& c : bpo.condiciones[r]) {
+                Hecho h;
+                h.nombre = nombreAtomo(sustituir(c, ligaduras));
+                inst.antecedente.condiciones.push_back(h);
+            }
+            inst.consecuente.nombre = nombreAtomo(sustituir(bpo.consecuentes[r], ligaduras));
+            inst.factorCertezaRegla = regla.factorCertezaRegla;
+            inst.prioridad = regla.prioridad;
+            bc.reglas.push_back(inst);
+            size_t i = vars.size();
+            while (i > 0 && ++indice[i - 1] == constantes.size()) indice[--i] = 0;
+            if (i == 0) break;
+        }
+    }
+    return bc;
+}
+
+// --- Ajuste de FCs con Casos Etiquetados ---
+
+// Derivadas parciales de combinarFc respecto a cada argumento
+void derivadasCombinarFc(double a, double b, double& da, double& db) {
+    if (a >= 1.0 || a <= -1.0) {
+        da = 1.0;
+        db = 0.0;
+    } else if (a >= 0 && b >= 0) {
+        da = 1 - b;
+        db = 1 - a;
+    } else if (a <= 0 && b <= 0) {
+        da = 1 + b;
+        db = 1 + a;
+    } else {
+        // (a + b) / (1 - m), con m el menor valor absoluto de los dos
+        double m = std::min(std::abs(a), std::abs(b));
+        double d = 1 - m;
+        double dm = (a + b) / (d * d); // Derivada respecto a m
+        da = 1 / d + (std::abs(a) <= std::abs(b) ? dm * (a < 0 ? -1.0 : 1.0) : 0.0);
+        db = 1 / d + (std::abs(a) <= std::abs(b) ? 0.0 : dm * (b < 0 ? -1.0 : 1.0));
+    }
+}
+
+// Una línea por caso, con el FC esperado del objetivo, en el orden del fichero de casos
+bool cargarEtiquetas(const std::string& nombreArchivo, std::vector<double>& etiquetas) {
+    std::ifstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de etiquetas: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::string linea;
+    while (std::getline(archivo, linea)) {
+        linea = trim(linea);
+        if (linea.empty()) continue;
+        size_t usados = 0;
+        double valor = 0;
+        try {
+            valor = std::stod(linea, &usados);
+        } catch (const std::exception&) {
+            usados = 0;
+        }
+        if (usados != linea.size() || !std::isfinite(valor)) {
+            std::cerr << "Error: Etiqueta inválida: " << linea << std::endl;
+            return false;
+        }
+        etiquetas.push_back(valor);
+    }
+    return true;
+}
+
+struct OpcionesEntrenamiento {
+    int epocas = 10;
+    int minilote = 1024;
+    double tasa = 0.01; // Tasa de aprendizaje de Adam
+    int hilos = 1;
+    unsigned semilla = 1;
+};
+
+// Estado de un hilo: la pasada por bloques con su cinta, los adjuntos por símbolo y carril, y
+// el gradiente del minilote sólo sobre las reglas tocadas (un minilote ve una parte pequeña
+// de una BC grande, así que ni se recorre ni se reduce el vector completo)
+struct EstadoEntrenamiento {
+    EstadoBloque bloque;
+    CintaBloque cinta;
+    std::vector<double> adjunto;   // [s * kCarriles + carril]
+    std::vector<double> gradiente; // Por regla compilada
+    std::vector<uint32_t> marca;   // Minilote en que se tocó cada regla
+    std::vector<int> tocadas;
+    double errorCuadratico = 0;
+    size_t casos = 0, omitidos = 0;
+};
+
+// Retropropaga por la cinta de un bloque el adjunto de los objetivos (dL/dFC de cada carril)
+// y acumula dL/dFC de cada regla. Es la pasada hacia delante al revés: los símbolos del cono
+// en orden inverso y, en cada uno, sus reglas de la última a la primera combinada.
+static void retropropagarBloque(const BaseCompilada& bcc, const BaseHechos* casos, int numCasos,
+                                const double* adjuntoObjetivo, EstadoEntrenamiento& est, uint32_t minilote) {
+    const EstadoBloque& bloque = est.bloque;
+    const CintaBloque& cinta = est.cinta;
+    for (int s : bloque.cono) std::fill_n(&est.adjunto[static_cast<size_t>(s) * kCarriles], kCarriles, 0.0);
+    for (int l = 0; l < numCasos; ++l) {
+        int objetivo = buscarSimbolo(bcc, casos[l].objetivo.nombre);
+        if (objetivo >= 0) est.adjunto[static_cast<size_t>(objetivo) * kCarriles + l] += adjuntoObjetivo[l];
+    }
+    for (size_t k = bloque.cono.size(); k-- > 0;) {
+        int s = bloque.cono[k];
+        double adjunto[kCarriles];
+        int atributo = bcc.atributoDe[s];
+        for (int l = 0; l < kCarriles; ++l) {
+            adjunto[l] = 0.0;
+            if (l >= numCasos) continue;
+            const EstadoInferencia& h = bloque.carril[l];
+            bool constante = h.epocaHecho[s] == h.epocaHechosActual
+                          || (atributo >= 0 && h.epocaAtributo[atributo] == h.epocaHechosActual);
+            if (!constante) adjunto[l] = est.adjunto[static_cast<size_t>(s) * kCarriles + l];
+        }
+        for (int t = cinta.inicioSimbolo[k + 1]; t-- > cinta.inicioSimbolo[k];) {
+            int r = cinta.reglas[t];
+            double fcRegla = bcc.fcRegla[r];
+            int inicio = bcc.inicioCondiciones[r], fin = bcc.inicioCondiciones[r + 1];
+            for (int l = 0; l < numCasos; ++l) {
+                double antecedente = cinta.antecedente[static_cast<size_t>(t) * kCarriles + l];
+                if (antecedente <= 0.0 || adjunto[l] == 0.0) continue; // No disparó, o no influye
+                double da, db;
+                derivadasCombinarFc(cinta.previo[static_cast<size_t>(t) * kCarriles + l], fcRegla * antecedente, da, db);
+                double adjuntoAportacion = adjunto[l] * db;
+                adjunto[l] *= da;
+                if (est.marca[r] != minilote) {
+                    est.marca[r] = minilote;
+                    est.gradiente[r] = 0.0;
+                    est.tocadas.push_back(r);
+                }
+                est.gradiente[r] += adjuntoAportacion * antecedente;
+                // El mínimo (o el máximo) es una de las condiciones: la primera con ese valor
+                for (int c = inicio; c < fin; ++c) {
+                    size_t i = static_cast<size_t>(bcc.condiciones[c]) * kCarriles + l;
+                    if (bloque.fc[i] == antecedente) {
+                        est.adjunto[i] += adjuntoAportacion * fcRegla;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Ajusta los FCs de las reglas a los casos etiquetados minimizando el error cuadrático medio
+// del FC del objetivo, con Adam por minilotes. Cada minilote se reparte en bloques entre los
+// hilos; los gradientes se calculan en modo adjunto por los operadores MYCIN sobre la cinta
+// de la evaluación por bloques. Los FCs se mantienen en [-1, 1]. Los casos cuyo cono tiene
+// ciclos no se pueden derivar y se omiten.
+int entrenarReglas(const std::string& ficheroReglas, const std::string& ficheroCasos, const std::string& ficheroEtiquetas,
+                   const std::string& ficheroSalida, const OpcionesEntrenamiento& opciones) {
+    BaseConocimiento bc;
+    if (!cargarReglas(ficheroReglas, bc)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    if (tieneVariables(bc)) {
+        std::cerr << "Error: El ajuste de FCs no se aplica a BCs con variables." << std::endl;
+        return 1;
+    }
+    std::vector<BaseHechos> casos;
+    std::vector<double> etiquetas;
+    if (!cargarCasos(ficheroCasos, casos) || !cargarEtiquetas(ficheroEtiquetas, etiquetas)) return 1;
+    if (etiquetas.size() != casos.size()) {
+        std::cerr << "Error: " << casos.size() << " casos y " << etiquetas.size() << " etiquetas." << std::endl;
+        return 1;
+    }
+
+    BaseCompilada bcc = compilarBase(bc, OrdenCompilacion::LOCALIDAD);
+    PlanBloques plan;
+    prepararPlanBloques(bcc, plan);
+    size_t n = bcc.simbolos.size(), m = bcc.fcRegla.size();
+    int hilos = std::max(1, opciones.hilos);
+    std::vector<std::unique_ptr<EstadoEntrenamiento>> estados;
+    for (int h = 0; h < hilos; ++h) {
+        estados.emplace_back(new EstadoEntrenamiento());
+        estados.back()->adjunto.assign(n * kCarriles, 0.0);
+        estados.back()->gradiente.assign(m, 0.0);
+        estados.back()->marca.assign(m, 0);
+    }
+
+    // Adam disperso: los momentos de una regla sólo avanzan en los minilotes que la tocan
+    std::vector<double> momento(m, 0.0), varianza(m, 0.0), gradiente(m, 0.0);
+    std::vector<uint32_t> pasos(m, 0), marca(m, 0);
+    std::vector<int> tocadas;
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+
+    std::vector<size_t> orden(casos.size());
+    for (size_t i = 0; i < orden.size(); ++i) orden[i] = i;
+    std::mt19937 gen(opciones.semilla);
+    size_t minilote = static_cast<size_t>(std::max(kCarriles, opciones.minilote));
+    uint32_t numMinilote = 0;
+    for (int epoca = 1; epoca <= opciones.epocas; ++epoca) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::shuffle(orden.begin(), orden.end(), gen);
+        for (auto& e : estados) {
+            e->errorCuadratico = 0;
+            e->casos = e->omitidos = 0;
+        }
+        for (size_t inicio = 0; inicio < orden.size(); inicio += minilote) {
+            size_t fin = std::min(orden.size(), inicio + minilote);
+            ++numMinilote;
+            std::atomic<size_t> siguiente(inicio);
+            auto trabajador = [&](int h) {
+                EstadoEntrenamiento& est = *estados[h];
+                est.tocadas.clear();
+                BaseHechos bloque[kCarriles];
+                double adjuntoObjetivo[kCarriles];
+                for (size_t i = siguiente.fetch_add(kCarriles); i < fin; i = siguiente.fetch_add(kCarriles)) {
+                    int numCasos = static_cast<int>(std::min<size_t>(kCarriles, fin - i));
+                    for (int l = 0; l < numCasos; ++l) bloque[l] = casos[orden[i + l]];
+                    evaluarBloque(bcc, plan, bloque, numCasos, est.bloque, &est.cinta);
+                    if (!est.cinta.valida) {
+                        est.omitidos += numCasos;
+                        continue;
+                    }
+                    for (int l = 0; l < numCasos; ++l) {
+                        double error = bloque[l].objetivo.factorCerteza - etiquetas[orden[i + l]];
+                        est.errorCuadratico += error * error;
+                        adjuntoObjetivo[l] = 2 * error / static_cast<double>(fin - inicio);
+                    }
+                    est.casos += numCasos;
+                    retropropagarBloque(bcc, bloque, numCasos, adjuntoObjetivo, est, numMinilote);
+                }
+            };
+            std::vector<std::thread> grupo;
+            for (int h = 1; h < hilos; ++h) grupo.emplace_back(trabajador, h);
+            trabajador(0);
+            for (auto& t : grupo) t.join();
+
+            tocadas.clear();
+            for (auto& e : estados) {
+                for (int r : e->tocadas) {
+                    if (marca[r] != numMinilote) {
+                        marca[r] = numMinilote;
+                        gradiente[r] = 0.0;
+                        tocadas.push_back(r);
+                    }
+                    gradiente[r] += e->gradiente[r];
+                }
+            }
+            for (int r : tocadas) {
+                ++pasos[r];
+                momento[r] = beta1 * momento[r] + (1 - beta1) * gradiente[r];
+                varianza[r] = beta2 * varianza[r] + (1 - beta2) * gradiente[r] * gradiente[r];
+                double corregidoM = momento[r] / (1 - std::pow(beta1, pasos[r]));
+                double corregidoV = varianza[r] / (1 - std::pow(beta2, pasos[r]));
+                bcc.fcRegla[r] -= opciones.tasa * corregidoM / (std::sqrt(corregidoV) + epsilon);
+                bcc.fcRegla[r] = std::max(-1.0, std::min(1.0, bcc.fcRegla[r]));
+            }
+        }
+        double errorCuadratico = 0;
+        size_t usados = 0, omitidos = 0;
+        for (auto& e : estados) {
+            errorCuadratico += e->errorCuadratico;
+            usados += e->casos;
+            omitidos += e->omitidos;
+        }
+        double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "Época " << epoca << ": ECM = " << (usados ? errorCuadratico / usados : 0.0)
+                  << " (" << usados << " casos, " << segundos << " s)";
+        if (omitidos) std::cout << ", " << omitidos << " omitidos por ciclos";
+        std::cout << std::endl;
+    }
+
+    for (size_t r = 0; r < m; ++r) bc.reglas[bcc.origenRegla[r]].factorCertezaRegla = bcc.fcRegla[r];
+    std::ofstream salida(ficheroSalida);
+    if (!salida.is_open()) {
+        std::cerr << "Error al crear el archivo de reglas: " << ficheroSalida << std::endl;
+        return 1;
+    }
+    escribirReglas(salida, bc);
+    return 0;
+}
+
+// --- Evaluación en Sombra de Dos Versiones ---
+
+// Compara una versión nueva de la BC (B) con la actual (A) sobre los mismos casos en una sola
+// pasada. Las dos versiones se funden en una BC: las reglas de A tal cual y, de B, sólo las de
+// los símbolos cuya definición cambia, con esos símbolos renombrados a "nombre@B". Un símbolo
+// se comparte si sus reglas tienen la misma huella estructural en las dos versiones y todas sus
+// condiciones se comparten: entonces su cono es idéntico y se evalúa una sola vez por caso.
+const char* const kSufijoSombra = "@B";
+
+// En un literal de comparación el sufijo va en el atributo, para que se siga resolviendo con
+// los hechos numéricos del caso
+static std::string renombrarSombra(const std::string& nombre) {
+    Comparacion comp;
+    if (!parsearComparacion(nombre, comp)) return nombre + kSufijoSombra;
+    return comp.atributo + kSufijoSombra + comp.canonico.substr(comp.atributo.size());
+}
+
+// Huella estructural de la definición de un símbolo: operador, FC y condiciones de cada una de
+// sus reglas, en orden de fichero (la combinación de signos mixtos depende del orden). El id y
+// la prioridad no influyen en el FC y no cuentan.
+static uint64_t huellaDefinicion(const std::vector<const Regla*>& reglas) {
+    uint64_t huella = 1469598103934665603ull;
+    auto mezclar = [&](const void* datos, size_t tamano) {
+        const unsigned char* p = static_cast<const unsigned char*>(datos);
+        for (size_t i = 0; i < tamano; ++i) {
+            huella ^= p[i];
+            huella *= 1099511628211ull;
+        }
+    };
+    for (const Regla* regla : reglas) {
+        uint8_t operador = static_cast<uint8_t>(regla->antecedente.operador);
+        uint32_t numCondiciones = static_cast<uint32_t>(regla->antecedente.condiciones.size());
+        mezclar(&operador, sizeof(operador));
+        mezclar(&regla->factorCertezaRegla, sizeof(double));
+        mezclar(&numCondiciones, sizeof(numCondiciones));
+        for (const auto& c : regla->antecedente.condiciones) mezclar(c.nombre.c_str(), c.nombre.size() + 1);
+    }
+    return huella;
+}
+
+// Confirma una coincidencia de huellas
+static bool mismaDefinicion(const std::vector<const Regla*>& a, const std::vector<const Regla*>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        const Regla& x = *a[i];
+        const Regla& y = *b[i];
+        if (x.antecedente.operador != y.antecedente.operador || x.factorCertezaRegla != y.factorCertezaRegla ||
+            x.antecedente.condiciones.size() != y.antecedente.condiciones.size()) return false;
+        for (size_t c = 0; c < x.antecedente.condiciones.size(); ++c) {
+            if (x.antecedente.condiciones[c].nombre != y.antecedente.condiciones[c].nombre) return false;
+        }
+    }
+    return true;
+}
+
+struct BaseSombra {
+    BaseConocimiento fusion;
+    std::unordered_map<std::string, std::string> renombrado;         // Símbolo cambiado -> nombre en la fusión
+    std::unordered_map<std::string, std::string> atributoRenombrado; // Atributo -> atributo@B
+    size_t reglasCompartidas = 0; // Reglas de B que se evalúan con las de A
+    size_t reglasPropias = 0;     // Reglas de B copiadas a la fusión
+};
+
+// Diferencia entre dos versiones A y B de una BC: los símbolos cuyo FC puede cambiar en algún caso
+struct CambiosBase {
+    std::unordered_map<std::string, uint8_t> simbolos; // Nombre -> bit 1 si aparece en A, bit 2 si en B
+    std::vector<std::string> cambiados;
+};
+
+bool calcularCambios(const BaseConocimiento& a, const BaseConocimiento& b, CambiosBase& cambios) {
+    if (tieneVariables(a) || tieneVariables(b)) {
+        std::cerr << "Error: La comparación de versiones no se aplica a BCs con variables." << std::endl;
+        return false;
+    }
+    // 1. Definición de cada símbolo en cada versión
+    std::unordered_map<std::string, std::vector<const Regla*>> definicionA, definicionB;
+    for (const auto& regla : a.reglas) {
+        definicionA[regla.consecuente.nombre].push_back(&regla);
+        cambios.simbolos[regla.consecuente.nombre] |= 1;
+        for (const auto& c : regla.antecedente.condiciones) cambios.simbolos[c.nombre] |= 1;
+    }
+    for (const auto& regla : b.reglas) {
+        definicionB[regla.consecuente.nombre].push_back(&regla);
+        cambios.simbolos[regla.consecuente.nombre] |= 2;
+        for (const auto& c : regla.antecedente.condiciones) cambios.simbolos[c.nombre] |= 2;
+    }
+    static const std::vector<const Regla*> kSinReglas;
+    auto definicion = [](const std::unordered_map<std::string, std::vector<const Regla*>>& d,
+                         const std::string& nombre) -> const std::vector<const Regla*>& {
+        auto it = d.find(nombre);
+        return it == d.end() ? kSinReglas : it->second;
+    };
+
+    // 2. Cambian los símbolos de B con otra definición en A y los que están en un ciclo: el FC
+    //    de un ciclo depende del símbolo por el que entra la evaluación, que con la otra versión
+    //    puede ser otro. Un cambio se propaga a todo lo que depende del símbolo.
+    BaseCompilada bccB = compilarBase(b, OrdenCompilacion::ARCHIVO);
+    ComponentesFuertes componentes;
+    IndiceHaciaDelante indice;
+    calcularComponentes(bccB, componentes);
+    construirIndiceHaciaDelante(bccB, indice);
+    std::vector<uint8_t> cambiado(bccB.simbolos.size(), 0);
+    std::vector<int> pendientes;
+    for (size_t s = 0; s < bccB.simbolos.size(); ++s) {
+        const auto& da = definicion(definicionA, bccB.simbolos[s]);
+        const auto& db = definicion(definicionB, bccB.simbolos[s]);
+        if (componentes.ciclica[componentes.componente[s]] || huellaDefinicion(da) != huellaDefinicion(db) ||
+            !mismaDefinicion(da, db)) {
+            cambiado[s] = 1;
+            pendientes.push_back(static_cast<int>(s));
+        }
+    }
+    while (!pendientes.empty()) {
+        int s = pendientes.back();
+        pendientes.pop_back();
+        for (int k = indice.inicioUsos[s]; k < indice.inicioUsos[s + 1]; ++k) {
+            int dependiente = bccB.consecuenteRegla[indice.usos[k]];
+            if (cambiado[dependiente]) continue;
+            cambiado[dependiente] = 1;
+            pendientes.push_back(dependiente);
+        }
+    }
+    for (size_t s = 0; s < bccB.simbolos.size(); ++s) {
+        if (cambiado[s]) cambios.cambiados.push_back(bccB.simbolos[s]);
+    }
+    // Un símbolo de A que no aparece en B también cambia: en B sólo puede ser un hecho del
+    // caso, sin reglas y sin resolverse como comparación
+    for (const auto& par : cambios.simbolos) {
+        if (par.second == 1) cambios.cambiados.push_back(par.first);
+    }
+    return true;
+}
+
+bool construirBaseSombra(const BaseConocimiento& a, const BaseConocimiento& b, BaseSombra& bs) {
+    CambiosBase cambios;
+    if (!calcularCambios(a, b, cambios)) return false;
+
+    // Nombres en la fusión de los símbolos cambiados
+    for (const auto& nombre : cambios.cambiados) {
+        std::string nuevo = renombrarSombra(nombre);
+        if (cambios.simbolos.count(nuevo)) {
+            std::cerr << "Error: El símbolo " << nuevo << " ya existe; no se puede renombrar " << nombre << "." << std::endl;
+            return false;
+        }
+        bs.renombrado[nombre] = nuevo;
+        Comparacion comp;
+        if (parsearComparacion(nombre, comp)) bs.atributoRenombrado[comp.atributo] = comp.atributo + kSufijoSombra;
+    }
+
+    // Fusión: A entera y, detrás, las reglas de B de los símbolos cambiados en orden de fichero
+    bs.fusion = a;
+    for (const auto& regla : b.reglas) {
+        auto it = bs.renombrado.find(regla.consecuente.nombre);
+        if (it == bs.renombrado.end()) {
+            bs.reglasCompartidas++;
+            continue;
+        }
+        Regla copia = regla;
+        copia.id += kSufijoSombra;
+        copia.consecuente.nombre = it->second;
+        for (auto& c : copia.antecedente.condiciones) {
+            auto cond = bs.renombrado.find(c.nombre);
+            if (cond != bs.renombrado.end()) c.nombre = cond->second;
+        }
+        bs.fusion.reglas.push_back(copia);
+        bs.reglasPropias++;
+    }
+    return true;
+}
+
+// Duplica en el caso los hechos de los símbolos y atributos renombrados, con el mismo FC
+void prepararCasoSombra(const BaseSombra& bs, BaseHechos& bh) {
+    std::vector<std::pair<std::string, double>> hechos;
+    for (const auto& par : bh.fc_memoria) {
+        auto it = bs.renombrado.find(par.first);
+        if (it != bs.renombrado.end()) hechos.emplace_back(it->second, par.second);
+    }
+    for (const auto& h : hechos) bh.fc_memoria[h.first] = h.second;
+    std::vector<Hecho> valores;
+    for (const auto& par : bh.valores) {
+        auto it = bs.atributoRenombrado.find(par.first);
+        if (it == bs.atributoRenombrado.end()) continue;
+        valores.push_back(par.second);
+        valores.back().nombre = it->second;
+    }
+    for (const auto& h : valores) bh.valores[h.nombre] = h;
+}
+
+// FC del objetivo en las dos versiones, sobre la fusión compilada y un caso ya pasado por
+// prepararCasoSombra. Las dos consultas comparten la memoria de trabajo, así que lo común se
+// calcula al evaluar la versión actual y la nueva sólo evalúa lo renombrado.
+template <typename Calculo = CalculoMycin>
+void evaluarSombra(const BaseSombra& bs, const BaseCompilada& bcc, const BaseHechos& bh, EstadoInferencia& est,
+                   double& fcActual, double& fcNuevo) {
+    prepararEstado(bcc, bh, est);
+    auto evaluar = [&](const std::string& nombre) {
+        int s = buscarSimbolo(bcc, nombre);
+        if (s >= 0) return evaluarSimbolo<Calculo>(bcc, est, s);
+        auto it = bh.fc_memoria.find(nombre); // Fuera de la BC sólo puede ser un hecho inicial
+        return it == bh.fc_memoria.end() ? 0.0 : it->second;
+    };
+    fcActual = evaluar(bh.objetivo.nombre);
+    auto it = bs.renombrado.find(bh.objetivo.nombre);
+    fcNuevo = it == bs.renombrado.end() ? fcActual : evaluar(it->second);
+}
+
+void evaluarSombra(TipoCalculo calculo, const BaseSombra& bs, const BaseCompilada& bcc, const BaseHechos& bh,
+                   EstadoInferencia& est, double& fcActual, double& fcNuevo) {
+    switch (calculo) {
+        case TipoCalculo::DIFUSO: return evaluarSombra<CalculoDifuso>(bs, bcc, bh, est, fcActual, fcNuevo);
+        case TipoCalculo::PROBABILISTICO: return evaluarSombra<CalculoProbabilistico>(bs, bcc, bh, est, fcActual, fcNuevo);
+        case TipoCalculo::LUKASIEWICZ: return evaluarSombra<CalculoLukasiewicz>(bs, bcc, bh, est, fcActual, fcNuevo);
+        case TipoCalculo::MYCIN: break;
+    }
+    evaluarSombra<CalculoMycin>(bs, bcc, bh, est, fcActual, fcNuevo);
+}
+
+// Evalúa los casos con las dos versiones y escribe aquellos en que los FCs difieren más que
+// la tolerancia. Devuelve 1 si hay divergencias, como --comparar-bench con las regresiones.
+int ejecutarSombra(const std::string& ficheroActual, const std::string& ficheroNuevo, const std::string& ficheroCasos,
+                   OrdenCompilacion orden, TipoCalculo calculo, int hilos, double tolerancia) {
+    BaseConocimiento actual, nueva;
+    if (!cargarReglas(ficheroActual, actual) || !cargarReglas(ficheroNuevo, nueva)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    std::vector<BaseHechos> casos;
+    if (!cargarCasos(ficheroCasos, casos)) return 1;
+    BaseSombra bs;
+    if (!construirBaseSombra(actual, nueva, bs)) return 1;
+    BaseCompilada bcc = compilarBase(bs.fusion, orden);
+
+    hilos = std::max(1, hilos);
+    std::vector<double> fcActual(casos.size()), fcNuevo(casos.size());
+    std::atomic<size_t> siguiente(0);
+    const size_t bloque = 64;
+    auto trabajador = [&]() {
+        EstadoInferencia est;
+        for (size_t inicio = siguiente.fetch_add(bloque); inicio < casos.size(); inicio = siguiente.fetch_add(bloque)) {
+            for (size_t i = inicio; i < std::min(inicio + bloque, casos.size()); ++i) {
+                prepararCasoSombra(bs, casos[i]);
+                evaluarSombra(calculo, bs, bcc, casos[i], est, fcActual[i], fcNuevo[i]);
+            }
+        }
+    };
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> grupo;
+    for (int h = 1; h < hilos; ++h) grupo.emplace_back(trabajador);
+    trabajador();
+    for (auto& t : grupo) t.join();
+    double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    size_t divergencias = 0;
+    for (size_t i = 0; i < casos.size(); ++i) {
+        if (std::abs(fcActual[i] - fcNuevo[i]) <= tolerancia) continue;
+        ++divergencias;
+        std::cout << "Caso " << i + 1 << ": " << casos[i].objetivo.nombre << ", FC actual = " << fcActual[i]
+                  << ", FC nuevo = " << fcNuevo[i] << '\n';
+    }
+    std::cout << "Sombra: " << casos.size() << " casos, " << divergencias << " divergencias (tolerancia "
+              << tolerancia << ", " << segundos << " s)" << std::endl;
+    std::cout << "Reglas de la versión nueva: " << bs.reglasCompartidas << " compartidas, " << bs.reglasPropias
+              << " propias; " << bs.renombrado.size() << " símbolos renombrados" << std::endl;
+    return divergencias == 0 ? 0 : 1;
+}
+
+// --- Bases Sintéticas y Benchmark ---
+
+// Genera una BC acíclica aleatoria con forma de árbol con solapamientos: las condiciones de
+// una regla que concluye hN se eligen entre h(3N+1) y h(3N+6), así que el cono de un objetivo
+// crece con su cercanía a h0. El orden de las reglas se baraja para simular un fichero
+// escrito sin ningún criterio de localidad.
+void generarBaseSintetica(int numSimbolos, int numReglas, unsigned semilla, BaseConocimiento& bc) {
+    std::mt19937 gen(semilla);
+    std::uniform_real_distribution<double> fc(-1.0, 1.0);
+    numSimbolos = std::max(numSimbolos, 2);
+    int numInternos = std::max(1, numSimbolos / 3); // Los demás son hojas (sólo hechos)
+    for (int i = 0; i < numReglas; ++i) {
+        Regla r;
+        r.id = "R" + std::to_string(i + 1);
+        int consecuente = std::uniform_int_distribution<int>(0, numInternos - 1)(gen);
+        int primera = std::min(3 * consecuente + 1, numSimbolos - 1);
+        int ultima = std::min(3 * consecuente + 6, numSimbolos - 1);
+        int numCond = std::uniform_int_distribution<int>(1, 3)(gen);
+        r.antecedente.operador = numCond == 1 ? OperadorLogico::NINGUNO
+                               : (gen() % 2 ? OperadorLogico::Y : OperadorLogico::O);
+        for (int c = 0; c < numCond; ++c) {
+            Hecho h;
+            h.nombre = "h" + std::to_string(std::uniform_int_distribution<int>(primera, ultima)(gen));
+            r.antecedente.condiciones.push_back(h);
+        }
+        r.consecuente.nombre = "h" + std::to_string(consecuente);
+        r.factorCertezaRegla = std::round(fc(gen) * 100) / 100;
+        bc.reglas.push_back(r);
+    }
+    std::shuffle(bc.reglas.begin(), bc.reglas.end(), gen);
+}
+
+// Genera una BH aleatoria sobre los símbolos sin reglas de la BC (aproximadamente la mitad conocidos)
+void generarHechosSinteticos(const BaseCompilada& bcc, unsigned semilla, BaseHechos& bh) {
+    std::mt19937 gen(semilla);
+    std::uniform_real_distribution<double> fc(-1.0, 1.0);
+    for (size_t s = 0; s < bcc.simbolos.size(); ++s) {
+        if (bcc.inicioReglasDe[s] != bcc.inicioReglasDe[s + 1] || gen() % 2) continue;
+        Hecho h;
+        h.nombre = bcc.simbolos[s];
+        h.factorCerteza = std::round(fc(gen) * 100) / 100;
+        bh.hechos_iniciales.push_back(h);
+        bh.fc_memoria[h.nombre] = h.factorCerteza;
+    }
+}
+
+// Muestras de un benchmark: microsegundos por operación, una muestra por repetición
+struct ResultadoBench {
+    std::string nombre;
+    std::vector<double> muestras;
+    bool conCache = false;         // Se pidieron los contadores de caché
+    double fallosCache = -1;       // Por operación; -1 si el núcleo no dio los contadores
+    double referenciasCache = -1;
+};
+
+// Contadores hardware de fallos y referencias de caché del hilo actual, en grupo para que se
+// programen juntos. Sólo cuentan en espacio de usuario, lo que basta con perf_event_paranoid
+// <= 2; sin PMU (muchas máquinas virtuales) o sin permiso, disponibles() es falso.
+class ContadoresCache {
+public:
+    ContadoresCache() {
+#ifdef SBR_PERF
+        fallos_ = abrir(PERF_COUNT_HW_CACHE_MISSES, -1);
+        if (fallos_ >= 0) referencias_ = abrir(PERF_COUNT_HW_CACHE_REFERENCES, fallos_);
+#endif
+    }
+    ContadoresCache(const ContadoresCache&) = delete;
+    ContadoresCache& operator=(const ContadoresCache&) = delete;
+    ~ContadoresCache() {
+#ifdef SBR_PERF
+        if (referencias_ >= 0) close(referencias_);
+        if (fallos_ >= 0) close(fallos_);
+#endif
+    }
+
+    bool disponibles() const { return fallos_ >= 0 && referencias_ >= 0; }
+
+    void iniciar() {
+#ifdef SBR_PERF
+        ioctl(fallos_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fallos_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    // Para los contadores y suma lo contado desde iniciar()
+    bool parar(uint64_t& fallos, uint64_t& referencias) {
+#ifdef SBR_PERF
+        ioctl(fallos_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t f = 0, r = 0;
+        if (read(fallos_, &f, sizeof(f)) != sizeof(f) || read(referencias_, &r, sizeof(r)) != sizeof(r)) return false;
+        fallos += f;
+        referencias += r;
+        return true;
+#else
+        (void)fallos;
+        (void)referencias;
+        return false;
+#endif
+    }
+
+private:
+#ifdef SBR_PERF
+    static int abrir(uint64_t evento, int grupo) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = evento;
+        attr.disabled = grupo < 0; // El líder arranca parado y controla el grupo
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, grupo, PERF_FLAG_FD_CLOEXEC));
+    }
+#endif
+    int fallos_ = -1;
+    int referencias_ = -1;
+};
+
+// Ejecuta los benchmarks de carga e inferencia (Prueba-1 y una BC sintética con cada orden
+// de compilación). Las consultas sintéticas de cada orden se miden también con contadores de
+// caché, para ver cuántos fallos por consulta ahorra la compilación por localidad.
+std::vector<ResultadoBench> medirBenchmarks(int numReglas, int numConsultas, unsigned semilla, int repeticiones) {
+    std::vector<ResultadoBench> resultados;
+    ContadoresCache cache;
+    auto cronometrar = [](int operaciones, const std::function<void()>& cuerpo) {
+        auto t0 = std::chrono::steady_clock::now();
+        cuerpo();
+        auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::micro>(t1 - t0).count() / std::max(1, operaciones);
+    };
+    auto medir = [&](const std::string& nombre, int operaciones, const std::function<void()>& cuerpo,
+                     bool conCache = false) {
+        cuerpo(); // Calentamiento
+        resultados.push_back({nombre, {}});
+        ResultadoBench& r = resultados.back();
+        r.conCache = conCache;
+        bool contar = conCache && cache.disponibles();
+        uint64_t fallos = 0, referencias = 0;
+        for (int rep = 0; rep < repeticiones; ++rep) {
+            if (contar) cache.iniciar();
+            r.muestras.push_back(cronometrar(operaciones, cuerpo));
+            if (contar) contar = cache.parar(fallos, referencias);
+        }
+        if (contar && repeticiones > 0) {
+            double total = static_cast<double>(std::max(1, operaciones)) * repeticiones;
+            r.fallosCache = fallos / total;
+            r.referenciasCache = referencias / total;
+        }
+    };
+
+    // Carga: Prueba-1 y una BC sintética serializada en memoria
+    const int cargasPrueba1 = 2000;
+    medir("carga_prueba1", cargasPrueba1, [&] {
+        for (int i = 0; i < cargasPrueba1; ++i) {
+            BaseConocimiento bc;
+            BaseHechos bh;
+            cargarReglasDesdeBuffer(kReglasPrueba1, std::strlen(kReglasPrueba1), bc);
+            cargarHechosDesdeBuffer(kHechosPrueba1, std::strlen(kHechosPrueba1), bh);
+        }
+    });
+    BaseConocimiento sintetica;
+    generarBaseSintetica(numReglas / 2, numReglas, semilla, sintetica);
+    std::ostringstream texto;
+    escribirReglas(texto, sintetica);
+    std::string textoSintetica = texto.str();
+    medir("carga_sintetica", 1, [&] {
+        BaseConocimiento bc;
+        cargarReglasDesdeBuffer(textoSintetica.data(), textoSintetica.size(), bc);
+    });
+
+    // Inferencia sobre Prueba-1
+    BaseConocimiento bcPrueba1;
+    BaseHechos bhPrueba1;
+    cargarReglasDesdeBuffer(kReglasPrueba1, std::strlen(kReglasPrueba1), bcPrueba1);
+    cargarHechosDesdeBuffer(kHechosPrueba1, std::strlen(kHechosPrueba1), bhPrueba1);
+    BaseCompilada bccPrueba1 = compilarBase(bcPrueba1);
+    EstadoInferencia estPrueba1;
+    const int consultasPrueba1 = 20000;
+    // Sin pasar por motorDeInferencia, que deja el objetivo en la BH: en la siguiente vuelta
+    // sería un hecho inicial y no se mediría la inferencia
+    int objetivoPrueba1 = buscarSimbolo(bccPrueba1, bhPrueba1.objetivo.nombre);
+    medir("inferencia_prueba1", consultasPrueba1, [&] {
+        for (int i = 0; i < consultasPrueba1; ++i) {
+            prepararEstado(bccPrueba1, bhPrueba1, estPrueba1);
+            evaluarSimbolo(bccPrueba1, estPrueba1, objetivoPrueba1);
+        }
+    });
+
+    // Inferencia sintética: la misma BH y las mismas consultas (por nombre) para cada orden
+    BaseHechos bh;
+    generarHechosSinteticos(compilarBase(sintetica, OrdenCompilacion::ARCHIVO), semilla, bh);
+    std::mt19937 gen(semilla);
+    std::vector<std::string> objetivos;
+    for (int q = 0; q < numConsultas; ++q) {
+        objetivos.push_back("h" + std::to_string(std::uniform_int_distribution<int>(0, numReglas / 200)(gen)));
+    }
+    auto consultas = [&](const BaseCompilada& bcc, PerfilReglas* registrar) {
+        EstadoInferencia est;
+        est.perfil = registrar;
+        prepararEstado(bcc, bh, est);
+        for (const auto& objetivo : objetivos) {
+            nuevaConsulta(est);
+            evaluarSimbolo(bcc, est, buscarSimbolo(bcc, objetivo));
+        }
+    };
+    BaseCompilada archivo = compilarBase(sintetica, OrdenCompilacion::ARCHIVO);
+    medir("inferencia_archivo", numConsultas, [&] { consultas(archivo, nullptr); }, true);
+    BaseCompilada local = compilarBase(sintetica, OrdenCompilacion::LOCALIDAD);
+    medir("inferencia_localidad", numConsultas, [&] { consultas(local, nullptr); }, true);
+    PerfilReglas perfil;
+    inicializarPerfil(sintetica, perfil);
+    consultas(local, &perfil);
+    BaseCompilada guiada = compilarBase(sintetica, OrdenCompilacion::LOCALIDAD, &perfil);
+    medir("inferencia_perfil", numConsultas, [&] { consultas(guiada, nullptr); }, true);
+    return resultados;
+}
+
+static double mediana(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t m = v.size() / 2;
+    return v.size() % 2 ? v[m] : (v[m - 1] + v[m]) / 2;
+}
+
+void imprimirBenchmarks(const std::vector<ResultadoBench>& resultados) {
+    for (const auto& r : resultados) {
+        std::cout << "  " << r.nombre << std::string(std::max<size_t>(1, 24 - r.nombre.size()), ' ')
+                  << mediana(r.muestras) << " us/op (mediana de " << r.muestras.size() << ")";
+        if (r.conCache && r.fallosCache < 0) {
+            std::cout << ", fallos de caché/op n/a";
+        } else if (r.conCache) {
+            std::cout << ", " << r.fallosCache << " fallos de caché/op ("
+                      << (r.referenciasCache > 0 ? 100 * r.fallosCache / r.referenciasCache : 0.0) << " % de "
+                      << r.referenciasCache << " referencias)";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Histograma de latencias logarítmico-lineal, como HdrHistogram: 2^kBitsSubcubeta cubetas por
+// potencia de dos, con un error relativo menor que 2^-kBitsSubcubeta
+struct HistogramaLatencia {
+    static const int kBitsSubcubeta = 7;
+    std::vector<uint64_t> cubetas = std::vector<uint64_t>(64 << kBitsSubcubeta, 0);
+    uint64_t total = 0;
+    int64_t maximo = 0;
+
+    static int indice(int64_t valor) {
+        uint64_t v = valor < 1 ? 1 : static_cast<uint64_t>(valor);
+        int exponente = 0;
+        while ((v >> exponente) > 1) ++exponente;
+        if (exponente < kBitsSubcubeta) return static_cast<int>(v); // Exacto por debajo de 2^kBitsSubcubeta
+        int sub = static_cast<int>((v >> (exponente - kBitsSubcubeta)) & ((1u << kBitsSubcubeta) - 1));
+        return ((exponente - kBitsSubcubeta + 1) << kBitsSubcubeta) + sub;
+    }
+    // Mayor valor que cae en la cubeta i
+    static int64_t valorSuperior(int i) {
+        int bloque = i >> kBitsSubcubeta, sub = i & ((1 << kBitsSubcubeta) - 1);
+        if (bloque == 0) return sub;
+        int exponente = bloque + kBitsSubcubeta - 1;
+        uint64_t paso = uint64_t(1) << (exponente - kBitsSubcubeta);
+        return static_cast<int64_t>((uint64_t(1) << exponente) + sub * paso + paso - 1);
+    }
+    void registrar(int64_t valor) {
+        ++cubetas[indice(valor)];
+        ++total;
+        maximo = std::max(maximo, valor);
+    }
+    void fusionar(const HistogramaLatencia& otro) {
+        for (size_t i = 0; i < cubetas.size(); ++i) cubetas[i] += otro.cubetas[i];
+        total += otro.total;
+        maximo = std::max(maximo, otro.maximo);
+    }
+    int64_t percentil(double q) const {
+        if (total == 0) return 0;
+        uint64_t objetivo = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+        uint64_t acumulado = 0;
+        for (size_t i = 0; i < cubetas.size(); ++i) {
+            acumulado += cubetas[i];
+            if (acumulado >= objetivo) return std::min(valorSuperior(static_cast<int>(i)), maximo);
+        }
+        return maximo;
+    }
+};
+
+// Distribución acumulada del histograma: "valor_us  percentil  cuenta" por cubeta no vacía
+static void escribirDistribucion(std::ostream& os, const std::string& titulo, const HistogramaLatencia& h) {
+    os << "# " << titulo << '\n';
+    uint64_t acumulado = 0;
+    for (size_t i = 0; i < h.cubetas.size(); ++i) {
+        if (h.cubetas[i] == 0) continue;
+        acumulado += h.cubetas[i];
+        int64_t valor = std::min(HistogramaLatencia::valorSuperior(static_cast<int>(i)), h.maximo);
+        os << valor / 1000.0 << '\t' << static_cast<double>(acumulado) / h.total << '\t' << acumulado << '\n';
+    }
+}
+
+// Commit del árbol actual: SBR_COMMIT si está definida, si no `git rev-parse`
+std::string commitActual() {
+    if (const char* entorno = std::getenv("SBR_COMMIT")) return entorno;
+    std::string commit;
+#ifdef SBR_POSIX
+    if (FILE* git = popen("git rev-parse --short HEAD 2>/dev/null", "r")) {
+        char buf[64];
+        if (std::fgets(buf, sizeof(buf), git)) commit = trim(buf);
+        pclose(git);
+    }
+#endif
+    return commit.empty() ? "desconocido" : commit;
+}
+
+// Formato: "# commit <hash>" y una línea por benchmark con el nombre y sus muestras
+bool guardarBenchmarks(const std::string& nombreArchivo, const std::vector<ResultadoBench>& resultados) {
+    std::ofstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo de resultados: " << nombreArchivo << std::endl;
+        return false;
+    }
+    archivo << "# commit " << commitActual() << '\n';
+    archivo.precision(9);
+    for (const auto& r : resultados) {
+        archivo << r.nombre;
+        for (double m : r.muestras) archivo << '\t' << m;
+        archivo << '\n';
+    }
+    return true;
+}
+
+bool cargarBenchmarks(const std::string& nombreArchivo, std::string& commit, std::vector<ResultadoBench>& resultados) {
+    std::ifstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de resultados: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::string linea;
+    while (std::getline(archivo, linea)) {
+        if (linea.rfind("# commit ", 0) == 0) {
+            commit = trim(linea.substr(9));
+            continue;
+        }
+        std::istringstream campos(linea);
+        ResultadoBench r;
+        if (!std::getline(campos, r.nombre, '\t')) continue;
+        double m;
+        while (campos >> m) r.muestras.push_back(m);
+        if (!r.muestras.empty()) resultados.push_back(r);
+    }
+    return true;
+}
+
+// Prueba U de Mann-Whitney bilateral con aproximación normal y corrección por empates.
+// Devuelve el p-valor de que ambas muestras provengan de la misma distribución.
+double pruebaMannWhitney(const std::vector<double>& a, const std::vector<double>& b) {
+    size_t n1 = a.size(), n2 = b.size(), n = n1 + n2;
+    if (n1 == 0 || n2 == 0) return 1.0;
+    std::vector<std::pair<double, int>> todos;
+    for (double x : a) todos.emplace_back(x, 0);
+    for (double x : b) todos.emplace_back(x, 1);
+    std::sort(todos.begin(), todos.end());
+    double sumaRangosA = 0.0, correccionEmpates = 0.0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && todos[j].first == todos[i].first) ++j;
+        double rangoMedio = (i + 1 + j) / 2.0; // Rangos i+1..j
+        for (size_t k = i; k < j; ++k) {
+            if (todos[k].second == 0) sumaRangosA += rangoMedio;
+        }
+        double t = static_cast<double>(j - i);
+        correccionEmpates += t * t * t - t;
+        i = j;
+    }
+    double u = sumaRangosA - n1 * (n1 + 1) / 2.0;
+    double media = n1 * n2 / 2.0;
+    double varianza = n1 * n2 / 12.0 * ((n + 1) - correccionEmpates / (static_cast<double>(n) * (n - 1)));
+    if (varianza <= 0) return 1.0;
+    double z = (std::abs(u - media) - 0.5) / std::sqrt(varianza); // Con corrección de continuidad
+    return std::erfc(std::max(0.0, z) / std::sqrt(2.0));
+}
+
+// Compara dos ejecuciones guardadas. Es una regresión que la mediana empeore más del
+// umbral (en %) con p < 0.05. Devuelve el número de regresiones.
+int compararBenchmarks(const std::string& ficheroBase, const std::string& ficheroNuevo, double umbral) {
+    std::string commitBase, commitNuevo;
+    std::vector<ResultadoBench> base, nuevo;
+    if (!cargarBenchmarks(ficheroBase, commitBase, base) || !cargarBenchmarks(ficheroNuevo, commitNuevo, nuevo)) return -1;
+    std::cout << "Comparando " << commitBase << " -> " << commitNuevo << " (umbral " << umbral << "%)" << std::endl;
+    int regresiones = 0;
+    for (const auto& n : nuevo) {
+        auto b = std::find_if(base.begin(), base.end(), [&](const ResultadoBench& r) { return r.nombre == n.nombre; });
+        if (b == base.end()) {
+            std::cout << "  " << n.nombre << ": sin referencia" << std::endl;
+            continue;
+        }
+        double mb = mediana(b->muestras), mn = mediana(n.muestras);
+        double cambio = mb > 0 ? 100.0 * (mn - mb) / mb : 0.0;
+        double p = pruebaMannWhitney(b->muestras, n.muestras);
+        bool significativo = p < 0.05;
+        const char* veredicto = !significativo ? "sin cambio significativo"
+                              : cambio > umbral ? "REGRESIÓN"
+                              : cambio < 0 ? "mejora" : "empeora dentro del umbral";
+        if (significativo && cambio > umbral) ++regresiones;
+        std::cout << "  " << n.nombre << ": " << mb << " -> " << mn << " us/op (" << (cambio >= 0 ? "+" : "")
+                  << cambio << "%, p = " << p << ") " << veredicto << std::endl;
+    }
+    return regresiones;
+}
+
+
+// --- Pruebas Diferenciales entre Motores ---
+
+// Evaluador de referencia: MYCIN directo sobre la BC sin compilar, en orden de fichero,
+// sin cortocircuitos ni saturación. Es lento a propósito, pero fácil de comprobar a mano.
+static double evaluarReferencia(const BaseConocimiento& bc, const std::string& simbolo,
+                                std::map<std::string, double>& memoria, std::map<std::string, bool>& enCurso) {
+    auto it = memoria.find(simbolo);
+    if (it != memoria.end()) return it->second;
+    if (enCurso[simbolo]) return 0.0;
+    enCurso[simbolo] = true;
+    double resultado = 0.0;
+    bool primera = true;
+    for (const auto& regla : bc.reglas) {
+        if (regla.consecuente.nombre != simbolo) continue;
+        double antecedente = 0.0;
+        for (size_t c = 0; c < regla.antecedente.condiciones.size(); ++c) {
+            double valor = evaluarReferencia(bc, regla.antecedente.condiciones[c].nombre, memoria, enCurso);
+            if (c == 0) antecedente = valor;
+            else if (regla.antecedente.operador == OperadorLogico::O) antecedente = std::max(antecedente, valor);
+            else antecedente = std::min(antecedente, valor);
+        }
+        if (antecedente <= 0.0) continue;
+        double aportacion = regla.factorCertezaRegla * antecedente;
+        resultado = primera ? aportacion : combinarFc(resultado, aportacion);
+        primera = false;
+    }
+    enCurso[simbolo] = false;
+    memoria[simbolo] = resultado;
+    return resultado;
+}
+
+double inferirReferencia(const BaseConocimiento& bc, const BaseHechos& bh) {
+    std::map<std::string, double> memoria = bh.fc_memoria;
+    auto resolverComparacion = [&](const std::string& nombre) {
+        Comparacion comp;
+        if (memoria.count(nombre) || !parsearComparacion(nombre, comp)) return;
+        auto it = bh.valores.find(comp.atributo);
+        if (it == bh.valores.end()) return;
+        double fc = it->second.factorCerteza;
+        memoria[nombre] = cumpleComparacion(comp.operador, it->second.valor, comp.umbral) ? fc : -fc;
+    };
+    for (const auto& regla : bc.reglas) {
+        resolverComparacion(regla.consecuente.nombre);
+        for (const auto& c : regla.antecedente.condiciones) resolverComparacion(c.nombre);
+    }
+    std::map<std::string, bool> enCurso;
+    return evaluarReferencia(bc, bh.objetivo.nombre, memoria, enCurso);
+}
+
+// Un motor optimizado construido sobre una BC, visto como una función BH -> FC del objetivo
+struct MotorBajoPrueba {
+    std::string nombre;
+    std::function<double(const BaseHechos&)> inferir;
+};
+
+// Todos los motores a comparar con la referencia. Cada motor nuevo se registra aquí.
+std::vector<MotorBajoPrueba> motoresBajoPrueba(const BaseConocimiento& bc, unsigned semilla) {
+    std::vector<MotorBajoPrueba> motores;
+    auto compilado = [&](const std::string& nombre, std::shared_ptr<BaseCompilada> bcc) {
+        auto est = std::make_shared<EstadoInferencia>();
+        motores.push_back({nombre, [bcc, est](const BaseHechos& bh) {
+            BaseHechos copia = bh;
+            return motorDeInferencia(*bcc, copia, *est);
+        }});
+    };
+    compilado("archivo", std::make_shared<BaseCompilada>(compilarBase(bc, OrdenCompilacion::ARCHIVO)));
+    compilado("localidad", std::make_shared<BaseCompilada>(compilarBase(bc, OrdenCompilacion::LOCALIDAD)));
+
+    // Un perfil aleatorio produce órdenes de reglas y condiciones arbitrarios
+    PerfilReglas perfil;
+    inicializarPerfil(bc, perfil);
+    std::mt19937 gen(semilla);
+    for (auto& c : perfil.reglas) {
+        c.evaluaciones = gen() % 100;
+        c.saturaciones = gen() % 100;
+        for (auto& e : c.evaluacionesCondicion) e = 1 + gen() % 100;
+        for (auto& k : c.cortesCondicion) k = gen() % 100;
+    }
+    compilado("perfil", std::make_shared<BaseCompilada>(compilarBase(bc, OrdenCompilacion::LOCALIDAD, &perfil)));
+
+    // Encadenamiento hacia delante: el FC no debe depender de la estrategia de la agenda
+    auto bccDelante = std::make_shared<BaseCompilada>(compilarBase(bc, OrdenCompilacion::LOCALIDAD));
+    auto indice = std::make_shared<IndiceHaciaDelante>();
+    construirIndiceHaciaDelante(*bccDelante, *indice);
+    for (EstrategiaAgenda estrategia : {EstrategiaAgenda::PRIORIDAD, EstrategiaAgenda::RECENCIA,
+                                        EstrategiaAgenda::ESPECIFICIDAD, EstrategiaAgenda::CERTEZA}) {
+        auto est = std::make_shared<EstadoHaciaDelante>();
+        OpcionesHaciaDelante opciones;
+        opciones.estrategia = estrategia;
+        motores.push_back({std::string("delante-") + nombreEstrategia(estrategia),
+                           [bccDelante, indice, est, opciones](const BaseHechos& bh) {
+            BaseHechos copia = bh;
+            return encadenarHaciaDelante(*bccDelante, *indice, copia, *est, opciones);
+        }});
+    }
+
+    // Punto fijo por componentes: sobre BCs acíclicas coincide con el motor hacia atrás
+    auto componentes = std::make_shared<ComponentesFuertes>();
+    calcularComponentes(*bccDelante, *componentes);
+    auto estFijo = std::make_shared<EstadoPuntoFijo>();
+    motores.push_back({"punto-fijo", [bccDelante, indice, componentes, estFijo](const BaseHechos& bh) {
+        BaseHechos copia = bh;
+        return evaluarPuntoFijo(*bccDelante, *componentes, *indice, copia, *estFijo, OpcionesPuntoFijo());
+    }});
+
+    // Evaluación por bloques, aquí con un solo carril ocupado (ejecutarPruebasDiferenciales
+    // comprueba además bloques llenos con todos los cálculos)
+    auto plan = std::make_shared<PlanBloques>();
+    prepararPlanBloques(*bccDelante, *plan);
+    auto estBloque = std::make_shared<EstadoBloque>();
+    motores.push_back({"bloque", [bccDelante, plan, estBloque](const BaseHechos& bh) {
+        BaseHechos copia = bh;
+        evaluarBloque(*bccDelante, *plan, &copia, 1, *estBloque);
+        return copia.objetivo.factorCerteza;
+    }});
+    return motores;
+}
+
+// Compara la referencia con cada motor sobre BCs y BHs aleatorias y sobre Prueba-1.
+// Devuelve el número de discrepancias mayores que la tolerancia.
+int ejecutarPruebasDiferenciales(int numCasos, unsigned semilla, double tolerancia) {
+    int discrepancias = 0;
+    auto informar = [&](const std::string& motor, const std::string& caso, double esperado, double obtenido) {
+        if (std::abs(esperado - obtenido) <= tolerancia) return;
+        if (++discrepancias <= 20) {
+            std::cout << "  DISCREPANCIA " << motor << " en " << caso << ": referencia " << esperado
+                      << ", motor " << obtenido << std::endl;
+        }
+    };
+
+    {
+        BaseConocimiento bc;
+        BaseHechos bh;
+        std::istringstream reglas(kReglasPrueba1), hechos(kHechosPrueba1);
+        if (!cargarReglas(reglas, bc) || !cargarHechos(hechos, bh)) {
+            std::cout << "  Fallo al cargar Prueba-1" << std::endl;
+            return 1;
+        }
+        informar("referencia", "Prueba-1", kResultadoPrueba1, inferirReferencia(bc, bh));
+        for (const auto& motor : motoresBajoPrueba(bc, semilla)) {
+            informar(motor.nombre, "Prueba-1", kResultadoPrueba1, motor.inferir(bh));
+        }
+    }
+
+    {
+        // Ciclo a <-> b con solución cerrada: a = 0.6 + 0.5*b*(1 - 0.6) y b = a, luego a = 0.75
+        BaseConocimiento bc;
+        BaseHechos bh;
+        std::istringstream reglas("3\nR1: Si e Entonces a, FC=0.6\nR2: Si b Entonces a, FC=0.5\nR3: Si a Entonces b, FC=1\n");
+        std::istringstream hechos("1\ne, FC=1\nObjetivo\na\n");
+        if (!cargarReglas(reglas, bc) || !cargarHechos(hechos, bh)) {
+            std::cout << "  Fallo al cargar la BC cíclica" << std::endl;
+            return 1;
+        }
+        BaseCompilada bcc = compilarBase(bc, OrdenCompilacion::LOCALIDAD);
+        IndiceHaciaDelante indice;
+        ComponentesFuertes componentes;
+        EstadoPuntoFijo est;
+        construirIndiceHaciaDelante(bcc, indice);
+        calcularComponentes(bcc, componentes);
+        double obtenido = evaluarPuntoFijo(bcc, componentes, indice, bh, est, OpcionesPuntoFijo());
+        if (std::abs(obtenido - 0.75) > std::max(tolerancia, 1e-6)) informar("punto-fijo", "ciclo a<->b", 0.75, obtenido);
+    }
+
+    std::mt19937 gen(semilla);
+    for (int caso = 0; caso < numCasos; ++caso) {
+        unsigned semillaCaso = gen();
+        std::mt19937 genCaso(semillaCaso);
+        int numSimbolos = 4 + genCaso() % 60;
+        BaseConocimiento bc;
+        generarBaseSintetica(numSimbolos, 1 + genCaso() % (2 * numSimbolos), semillaCaso, bc);
+        for (auto& regla : bc.reglas) { // Forzar también saturaciones y contradicciones ±1
+            if (genCaso() % 8 == 0) regla.factorCertezaRegla = genCaso() % 2 ? 1.0 : -1.0;
+        }
+        static const char* const kOperadores[] = {"<", "<=", "=", ">=", ">"};
+        for (auto& regla : bc.reglas) { // Literales de comparación sobre los atributos v0..v2
+            for (auto& c : regla.antecedente.condiciones) {
+                if (genCaso() % 5 != 0) continue;
+                c.nombre = "v" + std::to_string(genCaso() % 3) + kOperadores[genCaso() % 5] + std::to_string(genCaso() % 5);
+            }
+        }
+        std::vector<MotorBajoPrueba> motores = motoresBajoPrueba(bc, semillaCaso);
+        BaseCompilada bcc = compilarBase(bc, OrdenCompilacion::ARCHIVO);
+        PlanBloques plan;
+        prepararPlanBloques(bcc, plan);
+        std::vector<BaseHechos> bloque;
+        EstadoIntervalos estIntervalos;
+
+        // Versión nueva para la evaluación en sombra: FCs cambiados, una regla menos y una regla
+        // que concluye un literal de comparación a partir de una hoja
+        BaseConocimiento nueva = bc;
+        for (auto& regla : nueva.reglas) {
+            if (genCaso() % 6 == 0) regla.factorCertezaRegla = std::round(genCaso() % 201) / 100 - 1;
+        }
+        if (nueva.reglas.size() > 1 && genCaso() % 2) nueva.reglas.erase(nueva.reglas.begin() + genCaso() % nueva.reglas.size());
+        for (size_t s = 0; s < bcc.simbolos.size(); ++s) {
+            if (bcc.inicioReglasDe[s] != bcc.inicioReglasDe[s + 1] || bcc.atributoDe[s] >= 0) continue;
+            Regla regla;
+            regla.id = "Rnueva";
+            regla.antecedente.condiciones.push_back(Hecho());
+            regla.antecedente.condiciones.back().nombre = bcc.simbolos[s];
+            regla.consecuente.nombre = "v" + std::to_string(genCaso() % 3) + ">=2";
+            regla.factorCertezaRegla = 0.8;
+            nueva.reglas.push_back(regla);
+            break;
+        }
+        BaseSombra sombra;
+        if (!construirBaseSombra(bc, nueva, sombra)) return ++discrepancias;
+        BaseCompilada bccSombra = compilarBase(sombra.fusion, OrdenCompilacion::LOCALIDAD);
+        EstadoInferencia estSombra;
+
+        for (int consulta = 0; consulta < 8; ++consulta) {
+            BaseHechos bh;
+            generarHechosSinteticos(bcc, semillaCaso + consulta, bh);
+            for (auto& par : bh.fc_memoria) {
+                if (genCaso() % 4 == 0) par.second = 1.0;
+            }
+            if (genCaso() % 3 == 0) { // Un hecho inicial que también concluyen las reglas
+                bh.fc_memoria[bcc.simbolos[genCaso() % bcc.simbolos.size()]] = std::round(genCaso() % 201) / 100 - 1;
+            }
+            for (int v = 0; v < 3; ++v) { // Valores enteros para que también haya igualdades
+                if (genCaso() % 4 == 0) continue;
+                Hecho h;
+                h.nombre = "v" + std::to_string(v);
+                h.numerico = true;
+                h.valor = genCaso() % 5;
+                h.factorCerteza = std::round(genCaso() % 201) / 100 - 1;
+                bh.valores[h.nombre] = h;
+            }
+            bh.objetivo.nombre = bcc.simbolos[genCaso() % bcc.simbolos.size()];
+            double esperado = inferirReferencia(bc, bh);
+            std::string nombreCaso = "semilla " + std::to_string(semillaCaso) + " consulta " + std::to_string(consulta);
+            for (const auto& motor : motores) informar(motor.nombre, nombreCaso, esperado, motor.inferir(bh));
+            bloque.push_back(bh);
+
+            BaseHechos copiaSombra = bh;
+            double fcActual, fcNuevo;
+            prepararCasoSombra(sombra, copiaSombra);
+            evaluarSombra(sombra, bccSombra, copiaSombra, estSombra, fcActual, fcNuevo);
+            informar("sombra-actual", nombreCaso, esperado, fcActual);
+            informar("sombra-nueva", nombreCaso, inferirReferencia(nueva, bh), fcNuevo);
+
+            // Las cotas por intervalos contienen el resultado de cualquier forma de completar la BH
+            Intervalo cotas = inferirIntervalo(bcc, bh, estIntervalos);
+            for (int escenario = 0; escenario < 4; ++escenario) {
+                BaseHechos completa = bh;
+                for (size_t s = 0; s < bcc.simbolos.size(); ++s) {
+                    if (bcc.inicioReglasDe[s] != bcc.inicioReglasDe[s + 1] || completa.fc_memoria.count(bcc.simbolos[s])) continue;
+                    int atributo = bcc.atributoDe[s];
+                    if (atributo >= 0 && completa.valores.count(bcc.atributos[atributo])) continue;
+                    completa.fc_memoria[bcc.simbolos[s]] = genCaso() % 4 == 0 ? (genCaso() % 2 ? 1.0 : -1.0)
+                                                         : std::round(genCaso() % 201) / 100 - 1;
+                }
+                double valor = inferirReferencia(bc, completa);
+                if (valor < cotas.extremo[0] - tolerancia || valor > cotas.extremo[1] + tolerancia) {
+                    informar("intervalos", nombreCaso + " escenario " + std::to_string(escenario), valor,
+                             valor < cotas.extremo[0] ? cotas.extremo[0] : cotas.extremo[1]);
+                }
+            }
+        }
+
+        // Las consultas del caso como un bloque lleno, con cada cálculo frente al motor hacia atrás
+        static_assert(kCarriles == 8, "Un bloque por caso de 8 consultas");
+        for (TipoCalculo calculo : {TipoCalculo::MYCIN, TipoCalculo::DIFUSO, TipoCalculo::PROBABILISTICO, TipoCalculo::LUKASIEWICZ}) {
+            std::vector<BaseHechos> escalar = bloque, vectorial = bloque;
+            EstadoInferencia est;
+            EstadoBloque estBloque;
+            evaluarBloque(calculo, bcc, plan, vectorial.data(), static_cast<int>(vectorial.size()), estBloque);
+            for (size_t i = 0; i < escalar.size(); ++i) {
+                informar(std::string("bloque-") + nombreCalculo(calculo),
+                         "semilla " + std::to_string(semillaCaso) + " consulta " + std::to_string(i),
+                         motorDeInferencia(calculo, bcc, escalar[i], est), vectorial[i].objetivo.factorCerteza);
+            }
+        }
+    }
+    // Reglas con variables: la instanciación por consulta frente a la instanciación completa.
+    // Los predicados se estratifican (una regla de p_i sólo usa p_j con j > i) para que la BC
+    // instanciada sea acíclica y el resultado no dependa del orden de evaluación.
+    for (int caso = 0; caso < numCasos / 4; ++caso) {
+        unsigned semillaCaso = gen();
+        std::mt19937 genCaso(semillaCaso);
+        const int numPredicados = 6, numConstantes = 3;
+        int aridad[numPredicados];
+        for (int p = 0; p < numPredicados; ++p) aridad[p] = 1 + genCaso() % 2;
+        auto constante = [&]() { return "c" + std::to_string(genCaso() % numConstantes); };
+        auto atomo = [&](int p, const std::vector<std::string>& terminos) {
+            Atomo a;
+            a.predicado = "p" + std::to_string(p);
+            for (int i = 0; i < aridad[p]; ++i) a.argumentos.push_back(terminos[genCaso() % terminos.size()]);
+            return nombreAtomo(a);
+        };
+        BaseConocimiento bc;
+        int numReglas = 1 + genCaso() % 10;
+        for (int r = 0; r < numReglas; ++r) {
+            Regla regla;
+            regla.id = "R" + std::to_string(r + 1);
+            int cabeza = genCaso() % (numPredicados - 1);
+            int numCond = 1 + genCaso() % 3;
+            regla.antecedente.operador = numCond == 1 ? OperadorLogico::NINGUNO
+                                       : (genCaso() % 3 == 0 ? OperadorLogico::O : OperadorLogico::Y);
+            std::vector<std::string> terminos = {"X", "Y", constante()};
+            if (regla.antecedente.operador == OperadorLogico::O) terminos = {"X"}; // X en todas partes
+            std::vector<std::string> usadas;
+            for (int c = 0; c < numCond; ++c) {
+                int p = cabeza + 1 + genCaso() % (numPredicados - 1 - cabeza);
+                Hecho h;
+                h.nombre = atomo(p, terminos);
+                Atomo a = parsearAtomo(h.nombre);
+                for (const auto& t : a.argumentos) {
+                    if (esVariable(t)) usadas.push_back(t);
+                }
+                regla.antecedente.condiciones.push_back(h);
+            }
+            // El consecuente sólo usa variables del antecedente (en una regla "o", sólo X)
+            if (regla.antecedente.operador != OperadorLogico::O) usadas.push_back(constante());
+            else usadas.assign(1, "X");
+            regla.consecuente.nombre = atomo(cabeza, usadas);
+            regla.factorCertezaRegla = genCaso() % 8 == 0 ? (genCaso() % 2 ? 1.0 : -1.0)
+                                     : std::round(genCaso() % 201) / 100 - 1;
+            bc.reglas.push_back(regla);
+        }
+        BasePrimerOrden bpo;
+        if (!construirBasePrimerOrden(bc, bpo)) return ++discrepancias;
+        EstadoInferencia est;
+        for (int consulta = 0; consulta < 8; ++consulta) {
+            BaseHechos bh;
+            int numHechos = genCaso() % 12;
+            for (int i = 0; i < numHechos; ++i) {
+                int p = 1 + genCaso() % (numPredicados - 1);
+                bh.fc_memoria[atomo(p, {constante()})] = genCaso() % 4 == 0 ? 1.0 : std::round(genCaso() % 201) / 100 - 1;
+            }
+            bh.objetivo.nombre = atomo(genCaso() % 3, {constante()});
+            double esperado = inferirReferencia(instanciarCompleta(bpo, bh), bh);
+            BaseHechos copia = bh;
+            informar("primer-orden", "semilla " + std::to_string(semillaCaso) + " consulta " + std::to_string(consulta),
+                     esperado, inferirPrimerOrden(bpo, copia, est));
+        }
+    }
+
+    std::cout << "Pruebas diferenciales: " << numCasos << " BCs aleatorias + Prueba-1, "
+              << discrepancias << " discrepancias (tolerancia " << tolerancia << ")" << std::endl;
+    return discrepancias;
+}
+
+
+// --- Registro de Auditoría y Reproducción ---
+
+// Fichero binario de consultas atendidas, para reproducir incidencias de rendimiento.
+// Cabecera: "SBRAUD2\0", huella de la BC (u64) y hora de inicio (ns desde la época, i64).
+// Cada registro: llegada y duración de la inferencia en ns desde el inicio, FC obtenido
+// (f64), flujo (conexión o hilo), objetivo, hechos iniciales (nombre y FC) y hechos
+// numéricos (atributo, FC y valor). Enteros en varint y reales
+// en little-endian; los nombres se guardan como índice en un diccionario que crece con el
+// propio registro (un índice igual al tamaño del diccionario va seguido del nombre nuevo).
+
+static const char kMagiaAuditoria[8] = {'S', 'B', 'R', 'A', 'U', 'D', '2', '\0'};
+
+static void escribirVarint(std::string& salida, uint64_t valor) {
+    while (valor >= 0x80) {
+        salida.push_back(static_cast<char>((valor & 0x7f) | 0x80));
+        valor >>= 7;
+    }
+    salida.push_back(static_cast<char>(valor));
+}
+
+static bool leerVarint(std::istream& entrada, uint64_t& valor) {
+    valor = 0;
+    for (int desplazamiento = 0; desplazamiento < 64; desplazamiento += 7) {
+        int c = entrada.get();
+        if (c == std::char_traits<char>::eof()) return false;
+        valor |= static_cast<uint64_t>(c & 0x7f) << desplazamiento;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+static void escribirU64(std::string& salida, uint64_t valor) {
+    for (int i = 0; i < 8; ++i) salida.push_back(static_cast<char>(valor >> (8 * i)));
+}
+
+static bool leerU64(std::istream& entrada, uint64_t& valor) {
+    unsigned char bytes[8];
+    if (!entrada.read(reinterpret_cast<char*>(bytes), 8)) return false;
+    valor = 0;
+    for (int i = 0; i < 8; ++i) valor |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    return true;
+}
+
+static void escribirF64(std::string& salida, double valor) {
+    uint64_t bits;
+    std::memcpy(&bits, &valor, sizeof(bits));
+    escribirU64(salida, bits);
+}
+
+static bool leerF64(std::istream& entrada, double& valor) {
+    uint64_t bits;
+    if (!leerU64(entrada, bits)) return false;
+    std::memcpy(&valor, &bits, sizeof(valor));
+    return true;
+}
+
+// Huella de la BC (FNV-1a de su forma escrita): identifica la versión con la que se atendió
+uint64_t huellaBase(const BaseConocimiento& bc) {
+    std::ostringstream texto;
+    escribirReglas(texto, bc);
+    uint64_t huella = 1469598103934665603ull;
+    for (unsigned char c : texto.str()) {
+        huella ^= c;
+        huella *= 1099511628211ull;
+    }
+    return huella;
+}
+
+// Escritor del registro, compartido por los hilos que atienden consultas
+class RegistroAuditoria {
+public:
+    bool abrir(const std::string& nombreArchivo, const BaseConocimiento& bc) {
+        archivo.open(nombreArchivo, std::ios::binary);
+        if (!archivo.is_open()) {
+            std::cerr << "Error al crear el archivo de auditoría: " << nombreArchivo << std::endl;
+            return false;
+        }
+        inicio = std::chrono::steady_clock::now();
+        std::string cabecera(kMagiaAuditoria, sizeof(kMagiaAuditoria));
+        escribirU64(cabecera, huellaBase(bc));
+        escribirU64(cabecera, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()));
+        archivo.write(cabecera.data(), cabecera.size());
+        return true;
+    }
+    bool activo() const { return archivo.is_open(); }
+    std::chrono::steady_clock::time_point origen() const { return inicio; }
+
+    void registrar(const BaseHechos& bh, std::chrono::steady_clock::time_point llegada, int64_t duracionNs,
+                   double fc, uint32_t flujo) {
+        std::lock_guard<std::mutex> cerrojo(mutex);
+        if (!archivo.is_open()) return;
+        escribirVarint(pendiente, static_cast<uint64_t>(std::max<int64_t>(0,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(llegada - inicio).count())));
+        escribirVarint(pendiente, static_cast<uint64_t>(std::max<int64_t>(0, duracionNs)));
+        escribirF64(pendiente, fc);
+        escribirVarint(pendiente, flujo);
+        escribirNombre(bh.objetivo.nombre);
+        escribirVarint(pendiente, std::count_if(bh.hechos_iniciales.begin(), bh.hechos_iniciales.end(),
+                                                [](const Hecho& h) { return !h.numerico; }));
+        for (const auto& h : bh.hechos_iniciales) {
+            if (h.numerico) continue;
+            escribirNombre(h.nombre);
+            escribirF64(pendiente, h.factorCerteza);
+        }
+        escribirVarint(pendiente, bh.valores.size());
+        for (const auto& par : bh.valores) {
+            escribirNombre(par.first);
+            escribirF64(pendiente, par.second.factorCerteza);
+            escribirF64(pendiente, par.second.valor);
+        }
+        if (pendiente.size() >= (64 << 10)) vaciar();
+    }
+    void cerrar() {
+        std::lock_guard<std::mutex> cerrojo(mutex);
+        if (!archivo.is_open()) return;
+        vaciar();
+        archivo.close();
+    }
+    ~RegistroAuditoria() { cerrar(); }
+private:
+    void escribirNombre(const std::string& nombre) {
+        auto it = diccionario.find(nombre);
+        if (it != diccionario.end()) {
+            escribirVarint(pendiente, it->second);
+            return;
+        }
+        uint32_t id = static_cast<uint32_t>(diccionario.size());
+        diccionario.emplace(nombre, id);
+        escribirVarint(pendiente, id);
+        escribirVarint(pendiente, nombre.size());
+        pendiente += nombre;
+    }
+    void vaciar() {
+        archivo.write(pendiente.data(), pendiente.size());
+        archivo.flush();
+        pendiente.clear();
+    }
+    std::ofstream archivo;
+    std::mutex mutex;
+    std::string pendiente;
+    std::unordered_map<std::string, uint32_t> diccionario;
+    std::chrono::steady_clock::time_point inicio;
+};
+
+// Una consulta leída del registro
+struct ConsultaAuditada {
+    int64_t llegadaNs = 0;
+    int64_t duracionNs = 0;
+    double fc = 0.0;
+    uint32_t flujo = 0;
+    BaseHechos bh;
+};
+
+// Lee un registro completo. Un último registro truncado (el proceso murió a medio escribir)
+// se descarta con una advertencia.
+bool cargarAuditoria(const std::string& nombreArchivo, uint64_t& huella, std::vector<ConsultaAuditada>& consultas) {
+    std::ifstream archivo(nombreArchivo, std::ios::binary);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de auditoría: " << nombreArchivo << std::endl;
+        return false;
+    }
+    char magia[sizeof(kMagiaAuditoria)];
+    uint64_t horaInicio;
+    if (!archivo.read(magia, sizeof(magia)) || std::memcmp(magia, kMagiaAuditoria, sizeof(magia)) != 0 ||
+        !leerU64(archivo, huella) || !leerU64(archivo, horaInicio)) {
+        std::cerr << "Error: No es un registro de auditoría: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::vector<std::string> diccionario;
+    auto leerNombre = [&](std::string& nombre) {
+        uint64_t id, longitud;
+        if (!leerVarint(archivo, id) || id > diccionario.size()) return false;
+        if (id < diccionario.size()) {
+            nombre = diccionario[id];
+            return true;
+        }
+        if (!leerVarint(archivo, longitud) || longitud > (1u << 20)) return false;
+        nombre.resize(longitud);
+        if (!archivo.read(&nombre[0], longitud)) return false;
+        diccionario.push_back(nombre);
+        return true;
+    };
+    while (archivo.peek() != std::char_traits<char>::eof()) {
+        ConsultaAuditada c;
+        uint64_t llegada, duracion, flujo, numHechos;
+        bool ok = leerVarint(archivo, llegada) && leerVarint(archivo, duracion) && leerF64(archivo, c.fc) &&
+                  leerVarint(archivo, flujo) && leerNombre(c.bh.objetivo.nombre) && leerVarint(archivo, numHechos);
+        for (uint64_t i = 0; ok && i < numHechos; ++i) {
+            Hecho h;
+            ok = leerNombre(h.nombre) && leerF64(archivo, h.factorCerteza);
+            if (!ok) break;
+            c.bh.hechos_iniciales.push_back(h);
+            c.bh.fc_memoria[h.nombre] = h.factorCerteza;
+        }
+        uint64_t numValores = 0;
+        ok = ok && leerVarint(archivo, numValores);
+        for (uint64_t i = 0; ok && i < numValores; ++i) {
+            Hecho h;
+            h.numerico = true;
+            ok = leerNombre(h.nombre) && leerF64(archivo, h.factorCerteza) && leerF64(archivo, h.valor);
+            if (!ok) break;
+            c.bh.hechos_iniciales.push_back(h);
+            c.bh.valores[h.nombre] = h;
+        }
+        if (!ok) {
+            std::cerr << "Advertencia: Registro truncado tras " << consultas.size() << " consultas en "
+                      << nombreArchivo << std::endl;
+            break;
+        }
+        c.llegadaNs = static_cast<int64_t>(llegada);
+        c.duracionNs = static_cast<int64_t>(duracion);
+        c.flujo = static_cast<uint32_t>(flujo);
+        consultas.push_back(std::move(c));
+    }
+    return true;
+}
+
+// Vuelve a ejecutar las consultas de un registro sobre la misma BC. Sin ritmo original se
+// ejecutan seguidas en un hilo; con él, cada flujo del registro tiene su propio hilo y cada
+// consulta espera a su instante de llegada, así que se reproduce también la concurrencia.
+// Se compara el tiempo de inferencia con el registrado y se comprueba que el FC coincida.
+int reproducirAuditoria(const std::string& ficheroReglas, const std::string& ficheroAuditoria, bool ritmoOriginal,
+                        OrdenCompilacion orden) {
+    BaseConocimiento bc;
+    if (!cargarReglas(ficheroReglas, bc)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    uint64_t huella;
+    std::vector<ConsultaAuditada> consultas;
+    if (!cargarAuditoria(ficheroAuditoria, huella, consultas)) return 1;
+    if (huella != huellaBase(bc)) {
+        std::cerr << "Advertencia: La BC no es la versión con la que se registraron las consultas." << std::endl;
+    }
+    BaseCompilada bcc = compilarBase(bc, orden);
+    std::unique_ptr<BasePrimerOrden> bpo;
+    if (tieneVariables(bc)) {
+        bpo.reset(new BasePrimerOrden());
+        if (!construirBasePrimerOrden(bc, *bpo)) return 1;
+    }
+
+    std::vector<int64_t> duraciones(consultas.size(), 0);
+    std::vector<double> resultados(consultas.size(), 0.0);
+    auto ejecutar = [&](const std::vector<size_t>& indices, std::chrono::steady_clock::time_point t0) {
+        EstadoInferencia est;
+        for (size_t i : indices) {
+            if (ritmoOriginal) std::this_thread::sleep_until(t0 + std::chrono::nanoseconds(consultas[i].llegadaNs));
+            BaseHechos bh = consultas[i].bh;
+            auto inicio = std::chrono::steady_clock::now();
+            resultados[i] = bpo ? inferirPrimerOrden(*bpo, bh, est) : motorDeInferencia(bcc, bh, est);
+            duraciones[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - inicio).count();
+        }
+    };
+    std::map<uint32_t, std::vector<size_t>> porFlujo;
+    for (size_t i = 0; i < consultas.size(); ++i) porFlujo[ritmoOriginal ? consultas[i].flujo : 0].push_back(i);
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> grupo;
+    for (const auto& flujo : porFlujo) grupo.emplace_back(ejecutar, std::cref(flujo.second), t0);
+    for (auto& t : grupo) t.join();
+
+    HistogramaLatencia registrada, reproducida;
+    size_t discrepancias = 0;
+    for (size_t i = 0; i < consultas.size(); ++i) {
+        registrada.registrar(consultas[i].duracionNs);
+        reproducida.registrar(duraciones[i]);
+        if (std::abs(resultados[i] - consultas[i].fc) > 1e-12) ++discrepancias;
+    }
+    auto linea = [](const char* titulo, const HistogramaLatencia& h) {
+        std::cout << "  " << titulo << " p50 " << h.percentil(0.50) / 1000.0 << " us, p99 "
+                  << h.percentil(0.99) / 1000.0 << " us, máx " << h.maximo / 1000.0 << " us" << std::endl;
+    };
+    std::cout << "Reproducidas " << consultas.size() << " consultas en " << porFlujo.size() << " hilo(s), "
+              << discrepancias << " discrepancias de FC" << std::endl;
+    linea("registrada: ", registrada);
+    linea("reproducida:", reproducida);
+
+    // Las consultas más lentas del registro, para localizar el pico
+    std::vector<size_t> lentas(consultas.size());
+    for (size_t i = 0; i < lentas.size(); ++i) lentas[i] = i;
+    size_t mostrar = std::min<size_t>(10, lentas.size());
+    std::partial_sort(lentas.begin(), lentas.begin() + mostrar, lentas.end(),
+                      [&](size_t a, size_t b) { return consultas[a].duracionNs > consultas[b].duracionNs; });
+    for (size_t k = 0; k < mostrar; ++k) {
+        const auto& c = consultas[lentas[k]];
+        std::cout << "  #" << lentas[k] + 1 << " " << c.bh.objetivo.nombre << " (" << c.bh.hechos_iniciales.size()
+                  << " hechos): registrada " << c.duracionNs / 1000.0 << " us, reproducida "
+                  << duraciones[lentas[k]] / 1000.0 << " us" << std::endl;
+    }
+    return discrepancias == 0 ? 0 : 1;
+}
+
+// --- Resultados Binarios por Columnas ---
+
+// Fichero "SBRRES1\0" con los resultados del modo lote por columnas. Las filas (casos) van en
+// bloques de kFilasBloque y cada columna de un bloque se guarda por planos de bytes (el byte k
+// de todos los valores seguidos, así los FCs repetidos y los bytes altos quedan en rachas)
+// comprimidos con PackBits. Al final va el pie: columnas, tabla de símbolos y directorio de
+// bloques, y detrás su desplazamiento (u64) y otra vez la cabecera, para leerlo desde el final.
+static const char kCabeceraResultados[8] = {'S', 'B', 'R', 'R', 'E', 'S', '1', '\0'};
+const size_t kFilasBloque = 65536;
+const uint32_t kSinReferencia = 0xFFFFFFFFu;
+
+enum class TipoColumna : uint8_t {
+    SIMBOLO,   // u32: índice en la tabla de símbolos
+    FC,        // f64
+    REFERENCIA // u32: línea de la consulta en el fichero de --explicar, o kSinReferencia
+};
+
+struct ColumnaResultados {
+    std::string nombre;
+    TipoColumna tipo = TipoColumna::FC;
+    std::vector<uint32_t> enteros; // SIMBOLO y REFERENCIA
+    std::vector<double> fcs;       // FC
+};
+
+struct TablaResultados {
+    std::vector<ColumnaResultados> columnas;
+    std::vector<std::string> simbolos;
+    size_t filas() const {
+        if (columnas.empty()) return 0;
+        const ColumnaResultados& c = columnas[0];
+        return c.tipo == TipoColumna::FC ? c.fcs.size() : c.enteros.size();
+    }
+};
+
+// PackBits: un byte de control c < 128 va seguido de c+1 bytes literales; c >= 128, de un byte
+// que se repite c-125 veces (rachas de 3 a 130)
+static void comprimirPackBits(const uint8_t* datos, size_t n, std::string& salida) {
+    size_t i = 0;
+    while (i < n) {
+        size_t racha = 1;
+        while (i + racha < n && racha < 130 && datos[i + racha] == datos[i]) ++racha;
+        if (racha >= 3) {
+            salida.push_back(static_cast<char>(125 + racha));
+            salida.push_back(static_cast<char>(datos[i]));
+            i += racha;
+            continue;
+        }
+        size_t inicio = i;
+        while (i < n && i - inicio < 128 && !(i + 2 < n && datos[i] == datos[i + 1] && datos[i] == datos[i + 2])) ++i;
+        salida.push_back(static_cast<char>(i - inicio - 1));
+        salida.append(reinterpret_cast<const char*>(datos + inicio), i - inicio);
+    }
+}
+
+static bool descomprimirPackBits(const uint8_t* datos, size_t n, uint8_t* salida, size_t esperado) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        unsigned c = datos[i++];
+        if (c < 128) {
+            size_t k = c + 1;
+            if (i + k > n || o + k > esperado) return false;
+            std::memcpy(salida + o, datos + i, k);
+            i += k;
+            o += k;
+        } else {
+            size_t k = c - 125;
+            if (i >= n || o + k > esperado) return false;
+            std::memset(salida + o, datos[i++], k);
+            o += k;
+        }
+    }
+    return o == esperado;
+}
+
+static size_t anchuraColumna(TipoColumna tipo) {
+    return tipo == TipoColumna::FC ? 8 : 4;
+}
+
+// Filas [desde, hasta) de la columna, por planos de bytes (little-endian)
+static void planosColumna(const ColumnaResultados& c, size_t desde, size_t hasta, std::vector<uint8_t>& planos) {
+    size_t n = hasta - desde, ancho = anchuraColumna(c.tipo);
+    planos.resize(n * ancho);
+    for (size_t j = 0; j < n; ++j) {
+        uint64_t bits = c.enteros.empty() ? 0 : c.enteros[desde + j];
+        if (c.tipo == TipoColumna::FC) std::memcpy(&bits, &c.fcs[desde + j], sizeof(bits));
+        for (size_t k = 0; k < ancho; ++k) planos[k * n + j] = static_cast<uint8_t>(bits >> (8 * k));
+    }
+}
+
+bool guardarResultados(const std::string& nombreArchivo, const TablaResultados& tabla) {
+    std::ofstream archivo(nombreArchivo, std::ios::binary);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo de resultados: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::string binario(kCabeceraResultados, sizeof(kCabeceraResultados));
+    std::vector<std::pair<uint64_t, size_t>> bloques; // (desplazamiento, filas)
+    std::vector<uint8_t> planos;
+    std::string comprimido;
+    size_t filas = tabla.filas();
+    for (size_t desde = 0; desde < filas; desde += kFilasBloque) {
+        size_t hasta = std::min(filas, desde + kFilasBloque);
+        bloques.push_back({binario.size(), hasta - desde});
+        for (const auto& c : tabla.columnas) {
+            planosColumna(c, desde, hasta, planos);
+            comprimido.clear();
+            comprimirPackBits(planos.data(), planos.size(), comprimido);
+            escribirVarint(binario, comprimido.size());
+            binario += comprimido;
+        }
+    }
+    uint64_t pie = binario.size();
+    escribirVarint(binario, tabla.columnas.size());
+    for (const auto& c : tabla.columnas) {
+        binario.push_back(static_cast<char>(c.tipo));
+        escribirVarint(binario, c.nombre.size());
+        binario += c.nombre;
+    }
+    escribirVarint(binario, tabla.simbolos.size());
+    for (const auto& s : tabla.simbolos) {
+        escribirVarint(binario, s.size());
+        binario += s;
+    }
+    escribirVarint(binario, bloques.size());
+    for (const auto& b : bloques) {
+        escribirU64(binario, b.first);
+        escribirVarint(binario, b.second);
+    }
+    escribirU64(binario, pie);
+    binario.append(kCabeceraResultados, sizeof(kCabeceraResultados));
+    return static_cast<bool>(archivo.write(binario.data(), static_cast<std::streamsize>(binario.size())));
+}
+
+static bool leerCadena(std::istream& entrada, std::string& cadena) {
+    uint64_t longitud;
+    if (!leerVarint(entrada, longitud) || longitud > (1u << 20)) return false;
+    cadena.resize(longitud);
+    return static_cast<bool>(entrada.read(&cadena[0], static_cast<std::streamsize>(longitud)));
+}
+
+bool cargarResultados(const std::string& nombreArchivo, TablaResultados& tabla) {
+    std::ifstream archivo(nombreArchivo, std::ios::binary);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de resultados: " << nombreArchivo << std::endl;
+        return false;
+    }
+    auto invalido = [&]() {
+        std::cerr << "Error: " << nombreArchivo << " no es un fichero de resultados válido." << std::endl;
+        return false;
+    };
+    char cabecera[sizeof(kCabeceraResultados)];
+    uint64_t pie;
+    archivo.seekg(-static_cast<std::streamoff>(8 + sizeof(cabecera)), std::ios::end);
+    std::streamoff finPie = archivo.tellg();
+    if (finPie < 0 || !leerU64(archivo, pie) || !archivo.read(cabecera, sizeof(cabecera)) ||
+        std::memcmp(cabecera, kCabeceraResultados, sizeof(cabecera)) != 0 ||
+        pie > static_cast<uint64_t>(finPie)) return invalido();
+    // Los contadores del pie se acotan por los bytes que quedan hasta su final (cada símbolo
+    // ocupa al menos 1 byte y cada bloque 9) antes de reservar nada con ellos
+    auto quedan = [&]() { return static_cast<uint64_t>(finPie - archivo.tellg()); };
+
+    archivo.seekg(static_cast<std::streamoff>(pie));
+    uint64_t numColumnas, numSimbolos, numBloques;
+    if (!leerVarint(archivo, numColumnas) || numColumnas > 65536 || numColumnas * 2 > quedan()) return invalido();
+    tabla.columnas.assign(numColumnas, ColumnaResultados());
+    for (auto& c : tabla.columnas) {
+        int tipo = archivo.get();
+        if (tipo < 0 || tipo > static_cast<int>(TipoColumna::REFERENCIA) || !leerCadena(archivo, c.nombre)) return invalido();
+        c.tipo = static_cast<TipoColumna>(tipo);
+    }
+    if (!leerVarint(archivo, numSimbolos) || numSimbolos > quedan()) return invalido();
+    tabla.simbolos.assign(numSimbolos, std::string());
+    for (auto& s : tabla.simbolos) {
+        if (!leerCadena(archivo, s)) return invalido();
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> bloques;
+    if (!leerVarint(archivo, numBloques) || numBloques > quedan() / 9) return invalido();
+    bloques.reserve(numBloques);
+    for (uint64_t b = 0; b < numBloques; ++b) {
+        uint64_t desplazamiento, filas;
+        if (!leerU64(archivo, desplazamiento) || !leerVarint(archivo, filas) || filas > kFilasBloque) return invalido();
+        bloques.push_back({desplazamiento, filas});
+    }
+
+    std::vector<uint8_t> planos;
+    std::string comprimido;
+    for (const auto& b : bloques) {
+        archivo.seekg(static_cast<std::streamoff>(b.first));
+        size_t n = b.second;
+        for (auto& c : tabla.columnas) {
+            uint64_t tamano;
+            size_t ancho = anchuraColumna(c.tipo);
+            if (!leerVarint(archivo, tamano) || tamano > 2 * n * ancho + 16) return invalido();
+            comprimido.resize(tamano);
+            planos.resize(n * ancho);
+            if (!archivo.read(&comprimido[0], static_cast<std::streamsize>(tamano)) ||
+                !descomprimirPackBits(reinterpret_cast<const uint8_t*>(comprimido.data()), tamano, planos.data(), planos.size())) {
+                return invalido();
+            }
+            for (size_t j = 0; j < n; ++j) {
+                uint64_t bits = 0;
+                for (size_t k = 0; k < ancho; ++k) bits |= static_cast<uint64_t>(planos[k * n + j]) << (8 * k);
+                if (c.tipo == TipoColumna::FC) {
+                    double fc;
+                    std::memcpy(&fc, &bits, sizeof(fc));
+                    c.fcs.push_back(fc);
+                } else {
+                    if (c.tipo == TipoColumna::SIMBOLO && bits >= tabla.simbolos.size()) return invalido();
+                    c.enteros.push_back(static_cast<uint32_t>(bits));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Vuelca un fichero de resultados como CSV, con una columna de texto por columna del fichero
+int imprimirResultados(const std::string& nombreArchivo) {
+    TablaResultados tabla;
+    if (!cargarResultados(nombreArchivo, tabla)) return 1;
+    for (size_t k = 0; k < tabla.columnas.size(); ++k) std::cout << (k ? "," : "") << tabla.columnas[k].nombre;
+    std::cout << '\n';
+    for (size_t i = 0; i < tabla.filas(); ++i) {
+        for (size_t k = 0; k < tabla.columnas.size(); ++k) {
+            const ColumnaResultados& c = tabla.columnas[k];
+            if (k) std::cout << ',';
+            if (c.tipo == TipoColumna::FC) std::cout << c.fcs[i];
+            else if (c.tipo == TipoColumna::SIMBOLO) std::cout << tabla.simbolos[c.enteros[i]];
+            else if (c.enteros[i] != kSinReferencia) std::cout << c.enteros[i];
+        }
+        std::cout << '\n';
+    }
+    std::cout.flush();
+    return 0;
+}
+
+// --- Reevaluación Incremental tras Editar la BC ---
+
+// Reevalúa un archivo de casos ya resuelto con la versión A de la BC tras pasar a la versión B.
+// Sólo se infiere de nuevo en los casos cuyo objetivo está entre los símbolos cambiados (y no es
+// un hecho inicial del caso, que fija su FC en las dos versiones); del resto se copia la línea
+// guardada sin parsear sus hechos. La inferencia es proporcional al cambio; la lectura de los
+// ficheros sigue siendo una pasada secuencial. Los resultados pueden ser el texto del modo lote
+// o un fichero de --resultados (columnas objetivo y fc), y la salida tiene el mismo formato.
+// Deben haberse obtenido con el mismo cálculo de incertidumbre que se pasa aquí.
+
+// Salta un caso sin parsear sus hechos: cuenta las líneas no vacías igual que cargarHechos
+static bool saltarCaso(std::istream& archivo) {
+    std::string linea;
+    if (!std::getline(archivo, linea)) return false;
+    int pendientes = 0;
+    try {
+        pendientes = std::stoi(trim(linea)) + 2; // Hechos, "Objetivo" y el objetivo
+    } catch (const std::exception&) {
+        return false;
+    }
+    while (pendientes > 0 && std::getline(archivo, linea)) {
+        if (!trim(linea).empty()) --pendientes;
+    }
+    return pendientes == 0;
+}
+
+// Objetivo de una línea del modo lote: "objetivo, FC = valor"
+static bool parsearResultado(const std::string& linea, std::string& objetivo) {
+    size_t pos = linea.rfind(", FC = ");
+    if (pos == std::string::npos || pos == 0) return false;
+    objetivo = linea.substr(0, pos);
+    return true;
+}
+
+// Indica si el fichero empieza por la cabecera de --resultados
+static bool esFicheroResultados(const std::string& nombreArchivo) {
+    std::ifstream archivo(nombreArchivo, std::ios::binary);
+    char cabecera[sizeof(kCabeceraResultados)];
+    return archivo.read(cabecera, sizeof(cabecera)) && std::memcmp(cabecera, kCabeceraResultados, sizeof(cabecera)) == 0;
+}
+
+int reevaluarCasos(const std::string& ficheroActual, const std::string& ficheroNuevo, const std::string& ficheroCasos,
+                   const std::string& ficheroResultados, const std::string& ficheroSalida, OrdenCompilacion orden,
+                   TipoCalculo calculo) {
+    BaseConocimiento actual, nueva;
+    if (!cargarReglas(ficheroActual, actual) || !cargarReglas(ficheroNuevo, nueva)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    CambiosBase cambios;
+    if (!calcularCambios(actual, nueva, cambios)) return 1;
+    std::unordered_map<std::string, bool> afectado;
+    for (const auto& nombre : cambios.cambiados) afectado[nombre] = true;
+    BaseCompilada bcc = compilarBase(nueva, orden);
+
+    // En binario se carga la tabla entera, se corrigen en ella las filas reevaluadas y se guarda
+    bool binario = esFicheroResultados(ficheroResultados);
+    TablaResultados tabla;
+    ColumnaResultados* columnaObjetivo = nullptr;
+    ColumnaResultados* columnaFc = nullptr;
+    ColumnaResultados* columnaExplicacion = nullptr;
+    if (binario) {
+        if (!cargarResultados(ficheroResultados, tabla)) return 1;
+        for (auto& c : tabla.columnas) {
+            if (c.nombre == "objetivo" && c.tipo == TipoColumna::SIMBOLO) columnaObjetivo = &c;
+            else if (c.nombre == "fc" && c.tipo == TipoColumna::FC) columnaFc = &c;
+            else if (c.nombre == "explicacion" && c.tipo == TipoColumna::REFERENCIA) columnaExplicacion = &c;
+        }
+        if (!columnaObjetivo || !columnaFc) {
+            std::cerr << "Error: " << ficheroResultados << " no tiene las columnas objetivo y fc (¿se generó con --objetivos o --intervalos?)." << std::endl;
+            return 1;
+        }
+    }
+    std::ifstream casos(ficheroCasos), resultados;
+    if (!binario) resultados.open(ficheroResultados);
+    if (!casos.is_open() || (!binario && !resultados.is_open())) {
+        std::cerr << "Error al abrir " << (casos.is_open() ? ficheroResultados : ficheroCasos) << std::endl;
+        return 1;
+    }
+    std::ofstream salida;
+    if (!binario) {
+        salida.open(ficheroSalida);
+        if (!salida.is_open()) {
+            std::cerr << "Error al crear el archivo de resultados: " << ficheroSalida << std::endl;
+            return 1;
+        }
+    }
+
+    EstadoInferencia est;
+    size_t numCasos = 0, reevaluados = 0, fijados = 0;
+    std::string linea, objetivo;
+    while (binario ? numCasos < tabla.filas() : static_cast<bool>(std::getline(resultados, linea))) {
+        if (binario) {
+            objetivo = tabla.simbolos[columnaObjetivo->enteros[numCasos]];
+        } else if (!parsearResultado(linea, objetivo)) {
+            std::cerr << "Error: Resultado inválido en la línea " << numCasos + 1 << " de " << ficheroResultados << std::endl;
+            return 1;
+        }
+        ++numCasos;
+        casos >> std::ws;
+        if (!afectado.count(objetivo)) {
+            if (!saltarCaso(casos)) {
+                std::cerr << "Error en el caso " << numCasos << " de " << ficheroCasos << std::endl;
+                return 1;
+            }
+            if (!binario) salida << linea << '\n';
+            continue;
+        }
+        BaseHechos bh;
+        if (!cargarHechos(casos, bh)) {
+            std::cerr << "Error en el caso " << numCasos << " de " << ficheroCasos << std::endl;
+            return 1;
+        }
+        if (bh.objetivo.nombre != objetivo) {
+            std::cerr << "Error: El caso " << numCasos << " pregunta por " << bh.objetivo.nombre
+                      << " y el resultado guardado es de " << objetivo << std::endl;
+            return 1;
+        }
+        if (bh.fc_memoria.count(objetivo)) {
+            ++fijados;
+            if (!binario) salida << linea << '\n';
+            continue;
+        }
+        motorDeInferencia(calculo, bcc, bh, est);
+        ++reevaluados;
+        if (binario) {
+            columnaFc->fcs[numCasos - 1] = bh.objetivo.factorCerteza;
+            if (columnaExplicacion) columnaExplicacion->enteros[numCasos - 1] = kSinReferencia; // Era de la versión A
+        } else {
+            salida << objetivo << ", FC = " << bh.objetivo.factorCerteza << '\n';
+        }
+    }
+    if (casos >> std::ws && casos.peek() != std::char_traits<char>::eof()) {
+        std::cerr << "Error: " << ficheroCasos << " tiene más casos que resultados " << ficheroResultados << std::endl;
+        return 1;
+    }
+    double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "Reevaluación: " << numCasos << " casos, " << reevaluados << " reevaluados, " << fijados
+              << " con el objetivo como hecho; " << cambios.cambiados.size() << " símbolos cambiados ("
+              << segundos << " s)" << std::endl;
+    if (binario) return guardarResultados(ficheroSalida, tabla) ? 0 : 1;
+    return salida.good() ? 0 : 1;
+}
+
+// --- Índice de Casos ---
+
+// Fichero auxiliar "<casos>.idx" con el desplazamiento en bytes de cada caso de un fichero de
+// casos concatenados, para leer un caso o un rango sin recorrer el fichero desde el principio.
+// Formato: "SBRIDX1\0", tamaño y fecha de modificación (ns) del fichero indexado, número de
+// casos N y N+1 desplazamientos (el último es el fin del fichero), todos u64. Con anchura fija,
+// el rango [i, j) se lee directamente en la posición 32 + 8*i.
+static const char kCabeceraIndice[8] = {'S', 'B', 'R', 'I', 'D', 'X', '1', '\0'};
+
+// Fichero de casos en memoria: proyectado con mmap si se puede, o leído entero
+class FicheroMapeado {
+public:
+    FicheroMapeado() = default;
+    FicheroMapeado(const FicheroMapeado&) = delete;
+    FicheroMapeado& operator=(const FicheroMapeado&) = delete;
+    ~FicheroMapeado() {
+#ifdef SBR_POSIX
+        if (mapa_) munmap(mapa_, tamano_);
+#endif
+    }
+
+    bool abrir(const std::string& nombreArchivo) {
+#ifdef SBR_POSIX
+        int fd = open(nombreArchivo.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd >= 0 && fstat(fd, &info) == 0) {
+            tamano_ = static_cast<size_t>(info.st_size);
+            void* p = tamano_ ? mmap(nullptr, tamano_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            close(fd);
+            if (p != MAP_FAILED) {
+                mapa_ = p;
+                madvise(mapa_, tamano_, MADV_SEQUENTIAL);
+                return true;
+            }
+        } else if (fd >= 0) {
+            close(fd);
+        }
+#endif
+        std::ifstream archivo(nombreArchivo, std::ios::binary);
+        if (!archivo.is_open()) {
+            std::cerr << "Error al abrir el archivo de casos: " << nombreArchivo << std::endl;
+            return false;
+        }
+        copia_.assign(std::istreambuf_iterator<char>(archivo), std::istreambuf_iterator<char>());
+        tamano_ = copia_.size();
+        return true;
+    }
+
+    const char* datos() const { return mapa_ ? static_cast<const char*>(mapa_) : copia_.data(); }
+    size_t tamano() const { return tamano_; }
+
+private:
+    void* mapa_ = nullptr;
+    std::string copia_;
+    size_t tamano_ = 0;
+};
+
+// Tamaño y fecha de modificación del fichero, para detectar un índice desactualizado
+static bool firmaFichero(const std::string& nombreArchivo, uint64_t& tamano, uint64_t& modificacion) {
+#ifdef SBR_POSIX
+    struct stat info;
+    if (stat(nombreArchivo.c_str(), &info) != 0) return false;
+    tamano = static_cast<uint64_t>(info.st_size);
+    modificacion = static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(info.st_mtim.tv_nsec);
+    return true;
+#else
+    std::ifstream archivo(nombreArchivo, std::ios::binary | std::ios::ate);
+    if (!archivo.is_open()) return false;
+    tamano = static_cast<uint64_t>(archivo.tellg());
+    modificacion = 0;
+    return true;
+#endif
+}
+
+// Desplazamientos de los casos de un buffer, con las mismas reglas que cargarCasos y
+// cargarHechos (líneas en blanco ignoradas) pero sin parsear los hechos: sólo busca saltos
+// de línea. inicio recibe N+1 valores.
+static bool indexarBuffer(const char* datos, size_t tamano, std::vector<uint64_t>& inicio) {
+    auto esBlanco = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; };
+    auto finLinea = [&](size_t pos) {
+        const void* salto = std::memchr(datos + pos, '\n', tamano - pos);
+        return salto ? static_cast<size_t>(static_cast<const char*>(salto) - datos) : tamano;
+    };
+    inicio.clear();
+    size_t pos = 0;
+    while (true) {
+        while (pos < tamano && esBlanco(datos[pos])) ++pos;
+        if (pos == tamano) break;
+        inicio.push_back(pos);
+        size_t fin = finLinea(pos);
+        int pendientes = 0;
+        try {
+            pendientes = std::stoi(trim(std::string(datos + pos, fin - pos))) + 2; // Hechos, "Objetivo" y el objetivo
+        } catch (const std::exception&) {
+            std::cerr << "Error: Número de hechos inválido en el caso " << inicio.size() << std::endl;
+            return false;
+        }
+        pos = std::min(tamano, fin + 1);
+        while (pendientes > 0 && pos < tamano) {
+            fin = finLinea(pos);
+            for (size_t c = pos; c < fin; ++c) {
+                if (!esBlanco(datos[c])) {
+                    --pendientes;
+                    break;
+                }
+            }
+            pos = std::min(tamano, fin + 1);
+        }
+        if (pendientes > 0) {
+            std::cerr << "Error: Fin de archivo inesperado en el caso " << inicio.size() << std::endl;
+            return false;
+        }
+    }
+    inicio.push_back(tamano);
+    return true;
+}
+
+// Construye el índice de un fichero de casos de una vez y lo guarda junto a él
+int indexarCasos(const std::string& ficheroCasos) {
+    uint64_t tamano = 0, modificacion = 0;
+    FicheroMapeado fichero;
+    if (!firmaFichero(ficheroCasos, tamano, modificacion) || !fichero.abrir(ficheroCasos)) {
+        std::cerr << "Error al abrir el archivo de casos: " << ficheroCasos << std::endl;
+        return 1;
+    }
+    std::vector<uint64_t> inicio;
+    if (!indexarBuffer(fichero.datos(), fichero.tamano(), inicio)) return 1;
+
+    std::string binario(kCabeceraIndice, sizeof(kCabeceraIndice));
+    escribirU64(binario, tamano);
+    escribirU64(binario, modificacion);
+    escribirU64(binario, inicio.size() - 1);
+    for (uint64_t d : inicio) escribirU64(binario, d);
+    std::string nombreIndice = ficheroCasos + ".idx";
+    std::ofstream salida(nombreIndice, std::ios::binary);
+    if (!salida.is_open() || !salida.write(binario.data(), static_cast<std::streamsize>(binario.size()))) {
+        std::cerr << "Error al escribir el índice: " << nombreIndice << std::endl;
+        return 1;
+    }
+    std::cout << inicio.size() - 1 << " casos indexados en " << nombreIndice << std::endl;
+    return 0;
+}
+
+// Lee del índice los desplazamientos de los casos [desde, hasta) (base 0; hasta se recorta al
+// número de casos). Devuelve false si no hay índice o no corresponde al fichero actual.
+static bool leerIndiceCasos(const std::string& ficheroCasos, uint64_t desde, uint64_t& hasta, std::vector<uint64_t>& inicio) {
+    std::ifstream indice(ficheroCasos + ".idx", std::ios::binary);
+    if (!indice.is_open()) return false;
+    char cabecera[sizeof(kCabeceraIndice)];
+    uint64_t tamano, modificacion, numCasos, tamanoActual, modificacionActual;
+    if (!indice.read(cabecera, sizeof(cabecera)) || std::memcmp(cabecera, kCabeceraIndice, sizeof(cabecera)) != 0 ||
+        !leerU64(indice, tamano) || !leerU64(indice, modificacion) || !leerU64(indice, numCasos) ||
+        !firmaFichero(ficheroCasos, tamanoActual, modificacionActual) ||
+        tamano != tamanoActual || modificacion != modificacionActual) {
+        std::cerr << "Advertencia: Índice de " << ficheroCasos << " inválido o desactualizado; se ignora." << std::endl;
+        return false;
+    }
+    hasta = std::min(hasta, numCasos);
+    desde = std::min(desde, hasta);
+    inicio.resize(hasta - desde + 1);
+    indice.seekg(static_cast<std::streamoff>(sizeof(kCabeceraIndice) + 24 + 8 * desde));
+    for (auto& d : inicio) {
+        if (!leerU64(indice, d) || d > tamano) {
+            std::cerr << "Advertencia: Índice de " << ficheroCasos << " truncado; se ignora." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Carga los casos [desde, hasta) (base 0) del fichero proyectado en memoria, repartiendo el
+// parseo entre hilos. Con índice sólo se leen sus entradas del rango; sin él, se recorre el
+// fichero una vez buscando los saltos de línea.
+bool cargarRangoCasos(const std::string& ficheroCasos, uint64_t desde, uint64_t hasta, int hilos,
+                      std::vector<BaseHechos>& casos) {
+    FicheroMapeado fichero;
+    if (!fichero.abrir(ficheroCasos)) return false;
+    std::vector<uint64_t> inicio;
+    if (!leerIndiceCasos(ficheroCasos, desde, hasta, inicio)) {
+        if (!indexarBuffer(fichero.datos(), fichero.tamano(), inicio)) return false;
+        hasta = std::min<uint64_t>(hasta, inicio.size() - 1);
+        desde = std::min(desde, hasta);
+        inicio.erase(inicio.begin() + static_cast<std::ptrdiff_t>(hasta) + 1, inicio.end());
+        inicio.erase(inicio.begin(), inicio.begin() + static_cast<std::ptrdiff_t>(desde));
+    }
+    size_t numCasos = inicio.size() - 1;
+    casos.assign(numCasos, BaseHechos());
+    std::atomic<size_t> siguiente(0);
+    std::atomic<size_t> primerError(numCasos);
+    const size_t bloque = 64;
+    auto trabajador = [&]() {
+        for (size_t b = siguiente.fetch_add(bloque); b < numCasos; b = siguiente.fetch_add(bloque)) {
+            for (size_t i = b; i < std::min(b + bloque, numCasos); ++i) {
+                if (inicio[i + 1] < inicio[i] ||
+                    !cargarHechosDesdeBuffer(fichero.datos() + inicio[i], inicio[i + 1] - inicio[i], casos[i])) {
+                    size_t previo = primerError.load();
+                    while (i < previo && !primerError.compare_exchange_weak(previo, i)) {}
+                }
+            }
+        }
+    };
+    std::vector<std::thread> grupo;
+    for (int h = 1; h < hilos; ++h) grupo.emplace_back(trabajador);
+    trabajador();
+    for (auto& t : grupo) t.join();
+    if (primerError < numCasos) {
+        std::cerr << "Error en el caso " << desde + primerError + 1 << " de " << ficheroCasos << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --- Modo Servidor y Generador de Carga ---
+
+// Protocolo sobre un socket Unix de flujo: el cliente envía una línea con la longitud en
+// bytes de un bloque de hechos (el formato de los ficheros .hechos) seguida del bloque; el
+// servidor responde con una línea "objetivo, FC = x", o "ERROR" si el bloque no es válido.
+
+// Escribe una BH en el mismo formato que lee cargarHechos
+void escribirHechos(std::ostream& os, const BaseHechos& bh) {
+    std::streamsize precisionPrevia = os.precision(12);
+    os << bh.hechos_iniciales.size() << '\n';
+    for (const auto& h : bh.hechos_iniciales) {
+        os << h.nombre;
+        if (h.numerico) os << '=' << h.valor;
+        os << ", FC=" << h.factorCerteza << '\n';
+    }
+    os << "Objetivo\n" << bh.objetivo.nombre << '\n';
+    os.precision(precisionPrevia);
+}
+
+// Escribe una BC sintética como la del benchmark
+bool generarFicheroReglas(const std::string& nombreArchivo, int numReglas, unsigned semilla) {
+    std::ofstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo de reglas: " << nombreArchivo << std::endl;
+        return false;
+    }
+    BaseConocimiento bc;
+    generarBaseSintetica(numReglas / 2, numReglas, semilla, bc);
+    escribirReglas(archivo, bc);
+    return true;
+}
+
+// Escribe un fichero de casos concatenados con BHs aleatorias sobre una BC; el objetivo de
+// cada caso es un símbolo cualquiera con reglas
+bool generarFicheroCasos(const std::string& ficheroReglas, const std::string& nombreArchivo, int numCasos, unsigned semilla) {
+    BaseConocimiento bc;
+    if (!cargarReglas(ficheroReglas, bc)) return false;
+    BaseCompilada bcc = compilarBase(bc, OrdenCompilacion::ARCHIVO);
+    std::vector<int> conReglas;
+    for (size_t s = 0; s < bcc.simbolos.size(); ++s) {
+        if (bcc.inicioReglasDe[s] != bcc.inicioReglasDe[s + 1]) conReglas.push_back(static_cast<int>(s));
+    }
+    if (conReglas.empty()) {
+        std::cerr << "Error: La BC no tiene símbolos con reglas: " << ficheroReglas << std::endl;
+        return false;
+    }
+    std::ofstream archivo(nombreArchivo);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al crear el archivo de casos: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::mt19937 gen(semilla);
+    for (int i = 0; i < numCasos; ++i) {
+        BaseHechos bh;
+        generarHechosSinteticos(bcc, semilla + i, bh);
+        bh.objetivo.nombre = bcc.simbolos[conReglas[gen() % conReglas.size()]];
+        escribirHechos(archivo, bh);
+    }
+    return true;
+}
+
+// Separa un fichero de casos en el texto de cada bloque, validando cada uno con cargarHechos
+static bool cargarBloquesCasos(const std::string& nombreArchivo, std::vector<std::string>& bloques) {
+    std::ifstream archivo(nombreArchivo, std::ios::binary);
+    if (!archivo.is_open()) {
+        std::cerr << "Error al abrir el archivo de casos: " << nombreArchivo << std::endl;
+        return false;
+    }
+    std::string contenido((std::istreambuf_iterator<char>(archivo)), std::istreambuf_iterator<char>());
+    archivo.clear();
+    archivo.seekg(0);
+    while (archivo >> std::ws && archivo.peek() != std::char_traits<char>::eof()) {
+        std::streamoff inicio = archivo.tellg();
+        BaseHechos bh;
+        if (!cargarHechos(archivo, bh)) {
+            std::cerr << "Error en el caso " << bloques.size() + 1 << " de " << nombreArchivo << std::endl;
+            return false;
+        }
+        archivo.clear(); // El último bloque puede terminar en EOF sin salto de línea
+        std::streamoff fin = archivo.tellg();
+        if (fin < 0) fin = static_cast<std::streamoff>(contenido.size());
+        bloques.push_back(contenido.substr(inicio, fin - inicio));
+    }
+    return true;
+}
+
+#ifdef SBR_POSIX
+static bool escribirTodo(int fd, const std::string& datos) {
+    size_t enviado = 0;
+    while (enviado < datos.size()) {
+        ssize_t n = write(fd, datos.data() + enviado, datos.size() - enviado);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        enviado += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Lectura con buffer de líneas y bloques de tamaño conocido desde un descriptor
+class LectorSocket {
+public:
+    explicit LectorSocket(int fd) : fd(fd) {}
+    bool leerLinea(std::string& linea) {
+        size_t fin;
+        while ((fin = pendiente.find('\n', pos)) == std::string::npos) {
+            if (!rellenar()) return false;
+        }
+        linea.assign(pendiente, pos, fin - pos);
+        pos = fin + 1;
+        return true;
+    }
+    bool leerBytes(size_t n, std::string& datos) {
+        while (pendiente.size() - pos < n) {
+            if (!rellenar()) return false;
+        }
+        datos.assign(pendiente, pos, n);
+        pos += n;
+        return true;
+    }
+private:
+    bool rellenar() {
+        pendiente.erase(0, pos);
+        pos = 0;
+        char buf[65536];
+        ssize_t n;
+        do { n = read(fd, buf, sizeof(buf)); } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        pendiente.append(buf, static_cast<size_t>(n));
+        return true;
+    }
+    int fd;
+    std::string pendiente;
+    size_t pos = 0;
+};
+
+static bool direccionSocket(const std::string& ruta, sockaddr_un& dir) {
+    std::memset(&dir, 0, sizeof(dir));
+    dir.sun_family = AF_UNIX;
+    if (ruta.size() >= sizeof(dir.sun_path)) {
+        std::cerr << "Error: Ruta de socket demasiado larga: " << ruta << std::endl;
+        return false;
+    }
+    std::memcpy(dir.sun_path, ruta.c_str(), ruta.size() + 1);
+    return true;
+}
+
+static int conectarSocket(const std::string& ruta) {
+    sockaddr_un dir;
+    if (!direccionSocket(ruta, dir)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&dir), sizeof(dir)) < 0) {
+        std::cerr << "Error al conectar con " << ruta << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static volatile std::sig_atomic_t servidorDetenido = 0;
+static void detenerServidor(int) { servidorDetenido = 1; }
+
+// Conexiones abiertas del servidor: limita cuántas se atienden a la vez y, al detenerlo, las
+// corta y espera a sus hilos, que usan la BC compilada y el registro de auditoría
+class ConexionesServidor {
+public:
+    explicit ConexionesServidor(size_t maximo) : maximo_(maximo) {}
+
+    // Espera a que haya hueco para otra conexión; false si el servidor se detiene antes.
+    // Mientras tanto los clientes nuevos esperan en la cola de listen.
+    bool esperarHueco() {
+        std::unique_lock<std::mutex> cerrojo(m_);
+        while (abiertas_.size() >= maximo_) {
+            if (servidorDetenido) return false;
+            cv_.wait_for(cerrojo, std::chrono::milliseconds(100));
+        }
+        return true;
+    }
+
+    void alta(int fd) {
+        std::lock_guard<std::mutex> cerrojo(m_);
+        abiertas_.push_back(fd);
+    }
+
+    // Cierra el descriptor con el cerrojo tomado, para que cerrarTodas no lo corte ya reutilizado
+    void baja(int fd) {
+        std::lock_guard<std::mutex> cerrojo(m_);
+        abiertas_.erase(std::find(abiertas_.begin(), abiertas_.end(), fd));
+        close(fd);
+        cv_.notify_all();
+    }
+
+    // Despierta a los hilos bloqueados leyendo de su cliente y espera a que todos terminen;
+    // una consulta en curso acaba antes de que su hilo vea el cierre
+    void cerrarTodas() {
+        std::unique_lock<std::mutex> cerrojo(m_);
+        for (int fd : abiertas_) shutdown(fd, SHUT_RDWR);
+        cv_.wait(cerrojo, [this] { return abiertas_.empty(); });
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<int> abiertas_;
+    size_t maximo_;
+};
+
+const size_t kMaxConexionesServidor = 256;
+
+// Atiende las consultas de una conexión hasta que el cliente la cierra
+static void atenderConexion(int fd, const BaseCompilada& bcc, RegistroAuditoria* auditoria, uint32_t flujo,
+                            ConexionesServidor& conexiones) {
+    const size_t kMaxBloque = 64 << 20;
+    LectorSocket lector(fd);
+    EstadoInferencia est;
+    std::string linea, bloque;
+    while (lector.leerLinea(linea)) {
+        size_t longitud;
+        try {
+            longitud = std::stoul(linea);
+        } catch (const std::exception&) {
+            break; // Sin longitud válida no se puede resincronizar el flujo
+        }
+        if (longitud > kMaxBloque || !lector.leerBytes(longitud, bloque)) break;
+        BaseHechos bh;
+        std::ostringstream respuesta;
+        if (cargarHechosDesdeBuffer(bloque.data(), bloque.size(), bh)) {
+            auto llegada = std::chrono::steady_clock::now();
+            double fc = motorDeInferencia(bcc, bh, est);
+            if (auditoria) {
+                auditoria->registrar(bh, llegada, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - llegada).count(), fc, flujo);
+            }
+            respuesta << bh.objetivo.nombre << ", FC = " << bh.objetivo.factorCerteza << '\n';
+        } else {
+            respuesta << "ERROR\n";
+        }
+        if (!escribirTodo(fd, respuesta.str())) break;
+    }
+    conexiones.baja(fd);
+}
+
+// Carga y compila la BC una vez y atiende cada conexión en su propio hilo (hasta
+// kMaxConexionesServidor a la vez), hasta SIGINT o SIGTERM
+int ejecutarServidor(const std::string& rutaSocket, const std::string& ficheroReglas, OrdenCompilacion orden,
+                     const std::string& ficheroAuditoria) {
+    BaseConocimiento bc;
+    if (!cargarReglas(ficheroReglas, bc)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    if (tieneVariables(bc)) {
+        std::cerr << "Error: El modo servidor no admite BCs con variables." << std::endl;
+        return 1;
+    }
+    BaseCompilada bcc = compilarBase(bc, orden); // Compartida (sólo lectura) por los hilos de las conexiones
+    RegistroAuditoria auditoria;
+    if (!ficheroAuditoria.empty() && !auditoria.abrir(ficheroAuditoria, bc)) return 1;
+
+    std::signal(SIGPIPE, SIG_IGN);
+    struct sigaction accion = {};
+    accion.sa_handler = detenerServidor; // Sin SA_RESTART, para que accept vuelva con EINTR
+    sigemptyset(&accion.sa_mask);
+    sigaction(SIGINT, &accion, nullptr);
+    sigaction(SIGTERM, &accion, nullptr);
+    sockaddr_un dir;
+    if (!direccionSocket(rutaSocket, dir)) return 1;
+    unlink(rutaSocket.c_str());
+    int servidor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (servidor < 0 || bind(servidor, reinterpret_cast<sockaddr*>(&dir), sizeof(dir)) < 0 || listen(servidor, 128) < 0) {
+        std::cerr << "Error al escuchar en " << rutaSocket << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cout << "Servidor escuchando en " << rutaSocket << " (" << bc.reglas.size() << " reglas)" << std::endl;
+    ConexionesServidor conexiones(kMaxConexionesServidor);
+    uint32_t flujos = 0;
+    while (!servidorDetenido && conexiones.esperarHueco()) {
+        int cliente = accept(servidor, nullptr, nullptr);
+        if (cliente < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Error en accept: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        conexiones.alta(cliente);
+        std::thread(atenderConexion, cliente, std::cref(bcc), auditoria.activo() ? &auditoria : nullptr,
+                    flujos++, std::ref(conexiones)).detach();
+    }
+    close(servidor);
+    unlink(rutaSocket.c_str());
+    conexiones.cerrarTodas(); // Antes de que bcc y auditoria dejen de existir
+    auditoria.cerrar();
+    return servidorDetenido ? 0 : 1;
+}
+
+// Generador de carga en bucle abierto: la consulta k tiene su envío programado en
+// t0 + k / qps, con independencia de lo que tarden las anteriores, y se reparte entre las
+// conexiones por turnos. La latencia se mide desde el instante programado y no desde el envío
+// real, así que las esperas detrás de una respuesta lenta cuentan (corrección de la omisión
+// coordinada); el tiempo de servicio sin corregir se mide desde el envío real.
+int ejecutarGeneradorCarga(const std::string& rutaSocket, const std::string& ficheroCasos, double qps,
+                           double duracion, int conexiones, const std::string& ficheroHistograma) {
+    std::vector<std::string> bloques;
+    if (!cargarBloquesCasos(ficheroCasos, bloques)) return 1;
+    if (bloques.empty() || qps <= 0 || duracion <= 0) {
+        std::cerr << "Error: Hacen falta casos, --qps y --duracion positivos." << std::endl;
+        return 1;
+    }
+    std::vector<std::string> peticiones;
+    for (const auto& b : bloques) peticiones.push_back(std::to_string(b.size()) + "\n" + b);
+
+    std::signal(SIGPIPE, SIG_IGN);
+    conexiones = std::max(1, conexiones);
+    std::vector<int> sockets;
+    for (int c = 0; c < conexiones; ++c) {
+        int fd = conectarSocket(rutaSocket);
+        if (fd < 0) {
+            for (int abierto : sockets) close(abierto);
+            return 1;
+        }
+        sockets.push_back(fd);
+    }
+
+    const uint64_t numConsultas = static_cast<uint64_t>(std::llround(qps * duracion));
+    const double periodoNs = 1e9 / qps;
+    std::vector<HistogramaLatencia> corregida(conexiones), servicio(conexiones);
+    std::vector<uint64_t> errores(conexiones, 0);
+    auto t0 = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+    auto cliente = [&](int c) {
+        LectorSocket lector(sockets[c]);
+        std::string respuesta;
+        for (uint64_t k = c; k < numConsultas; k += conexiones) {
+            auto programado = t0 + std::chrono::nanoseconds(static_cast<int64_t>(k * periodoNs));
+            std::this_thread::sleep_until(programado);
+            auto envio = std::chrono::steady_clock::now();
+            if (!escribirTodo(sockets[c], peticiones[k % peticiones.size()]) || !lector.leerLinea(respuesta)) {
+                errores[c] += (numConsultas - k + conexiones - 1) / conexiones; // La conexión está caída
+                break;
+            }
+            auto fin = std::chrono::steady_clock::now();
+            if (respuesta == "ERROR") ++errores[c];
+            corregida[c].registrar(std::chrono::duration_cast<std::chrono::nanoseconds>(fin - programado).count());
+            servicio[c].registrar(std::chrono::duration_cast<std::chrono::nanoseconds>(fin - envio).count());
+        }
+    };
+    std::vector<std::thread> grupo;
+    for (int c = 0; c < conexiones; ++c) grupo.emplace_back(cliente, c);
+    for (auto& t : grupo) t.join();
+    double transcurrido = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    for (int fd : sockets) close(fd);
+
+    HistogramaLatencia totalCorregida, totalServicio;
+    uint64_t totalErrores = 0;
+    for (int c = 0; c < conexiones; ++c) {
+        totalCorregida.fusionar(corregida[c]);
+        totalServicio.fusionar(servicio[c]);
+        totalErrores += errores[c];
+    }
+    auto linea = [](const char* titulo, const HistogramaLatencia& h) {
+        std::cout << "  " << titulo << " p50 " << h.percentil(0.50) / 1000.0 << " us, p99 "
+                  << h.percentil(0.99) / 1000.0 << " us, p999 " << h.percentil(0.999) / 1000.0
+                  << " us, máx " << h.maximo / 1000.0 << " us" << std::endl;
+    };
+    std::cout << "Carga: " << numConsultas << " consultas a " << qps << " qps sobre " << conexiones
+              << " conexiones (" << bloques.size() << " casos distintos)" << std::endl;
+    std::cout << "  completadas " << totalCorregida.total << ", errores " << totalErrores << ", rendimiento "
+              << totalCorregida.total / transcurrido << " consultas/s" << std::endl;
+    linea("latencia (corregida):  ", totalCorregida);
+    linea("servicio (sin corregir):", totalServicio);
+
+    if (!ficheroHistograma.empty()) {
+        std::ofstream archivo(ficheroHistograma);
+        if (!archivo.is_open()) {
+            std::cerr << "Error al crear el archivo de histograma: " << ficheroHistograma << std::endl;
+            return 1;
+        }
+        archivo << "# valor_us\tpercentil\tcuenta\n";
+        escribirDistribucion(archivo, "latencia corregida", totalCorregida);
+        escribirDistribucion(archivo, "servicio sin corregir", totalServicio);
+    }
+    return totalErrores == 0 ? 0 : 1;
+}
+#else
+int ejecutarServidor(const std::string&, const std::string&, OrdenCompilacion, const std::string&) {
+    std::cerr << "Error: El modo servidor necesita sockets Unix." << std::endl;
+    return 1;
+}
+
+int ejecutarGeneradorCarga(const std::string&, const std::string&, double, double, int, const std::string&) {
+    std::cerr << "Error: El generador de carga necesita sockets Unix." << std::endl;
+    return 1;
+}
+#endif
+
+
+// --- Puntos de Entrada para libFuzzer ---
+//
+// Cada objetivo se compila por separado sin main(), por ejemplo:
+//   clang++ -std=c++17 -O1 -g -fsanitize=fuzzer,address,undefined -DSBR_FUZZ_REGLAS sbr.cpp -o fuzz_reglas
+//   ./fuzz_reglas -seed_inputs=prueba1/BC-1.txt -max_len=4096 corpus_reglas/
+//   SBR_FUZZ_REGLAS  cargarReglas sobre un flujo, compilación de la BC e inferencia de cada símbolo
+//   SBR_FUZZ_HECHOS  cargarHechos sobre un flujo de casos concatenados (semilla: prueba1/BH-1.txt)
+//   SBR_FUZZ_BUFFER  variantes sobre buffer de ambos cargadores con la misma entrada
+//                    (semillas: prueba1/BC-1.txt,prueba1/BH-1.txt)
+// Objetivo de rendimiento: más de 10.000 ejecuciones/s por núcleo con -max_len=4096; por eso
+// los mensajes de error de los cargadores se silencian en LLVMFuzzerInitialize.
+// No hay todavía un formato binario de BC, así que no tiene punto de entrada propio.
+#if defined(SBR_FUZZ_REGLAS) || defined(SBR_FUZZ_HECHOS) || defined(SBR_FUZZ_BUFFER)
+#define SBR_FUZZ 1
+
+// Recorre toda la BC compilada con una BH vacía y con otra en la que todo vale 1
+static void ejercitarMotor(const BaseConocimiento& bc) {
+    BaseCompilada bcc = compilarBase(bc);
+    EstadoInferencia est;
+    for (int todoCierto = 0; todoCierto < 2; ++todoCierto) {
+        BaseHechos bh;
+        if (todoCierto) {
+            for (const auto& nombre : bcc.simbolos) bh.fc_memoria[nombre] = 1.0;
+        }
+        prepararEstado(bcc, bh, est);
+        for (size_t s = 0; s < bcc.simbolos.size(); ++s) evaluarSimbolo(bcc, est, static_cast<int>(s));
+    }
+}
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    std::cerr.setstate(std::ios::failbit);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* datos, size_t tamano) {
+    const char* texto = reinterpret_cast<const char*>(datos);
+#if defined(SBR_FUZZ_REGLAS)
+    std::istringstream flujo(std::string(texto, tamano));
+    BaseConocimiento bc;
+    if (cargarReglas(flujo, bc)) ejercitarMotor(bc);
+#elif defined(SBR_FUZZ_HECHOS)
+    std::istringstream flujo(std::string(texto, tamano));
+    for (int caso = 0; caso < 64 && flujo >> std::ws && flujo.peek() != std::char_traits<char>::eof(); ++caso) {
+        BaseHechos bh;
+        if (!cargarHechos(flujo, bh)) break;
+    }
+#else
+    BaseConocimiento bc;
+    if (cargarReglasDesdeBuffer(texto, tamano, bc)) ejercitarMotor(bc);
+    BaseHechos bh;
+    cargarHechosDesdeBuffer(texto, tamano, bh);
+#endif
+    return 0;
+}
+#endif
+
+
+// --- Biblioteca Compartida (SBR_BIBLIOTECA) ---
+//
+// API en C para cargar una BC y evaluar matrices de casos desde otros lenguajes (sbr.py la
+// envuelve con ctypes y NumPy). Se compila sin main():
+//   g++ -std=c++17 -O2 -shared -fPIC -pthread -DSBR_BIBLIOTECA sbr.cpp -o libsbr.so
+// Los casos son una matriz densa filas x columnas de FCs en orden de filas; cada columna es un
+// símbolo de la BC (id de sbr_simbolo, o -1 si no está) y NaN es "sin hecho". La salida es otra
+// matriz filas x objetivos que rellena el llamante. Ninguna de las dos se copia.
+#ifdef SBR_BIBLIOTECA
+struct BaseBiblioteca {
+    BaseConocimiento bc;
+    BaseCompilada bcc;
+};
+
+extern "C" {
+
+// BC compilada o nullptr si no se pudo cargar (el motivo va a stderr)
+void* sbr_cargar(const char* ficheroReglas) {
+    std::unique_ptr<BaseBiblioteca> base(new BaseBiblioteca());
+    if (!cargarReglas(ficheroReglas, base->bc)) return nullptr;
+    if (tieneVariables(base->bc)) {
+        std::cerr << "Error: La biblioteca no admite BCs con variables." << std::endl;
+        return nullptr;
+    }
+    base->bcc = compilarBase(base->bc);
+    return base.release();
+}
+
+void sbr_liberar(void* base) {
+    delete static_cast<BaseBiblioteca*>(base);
+}
+
+int sbr_num_simbolos(const void* base) {
+    return static_cast<int>(static_cast<const BaseBiblioteca*>(base)->bcc.simbolos.size());
+}
+
+const char* sbr_nombre_simbolo(const void* base, int simbolo) {
+    return static_cast<const BaseBiblioteca*>(base)->bcc.simbolos[simbolo].c_str();
+}
+
+int sbr_simbolo(const void* base, const char* nombre) {
+    return buscarSimbolo(static_cast<const BaseBiblioteca*>(base)->bcc, nombre);
+}
+
+// Evalúa cada fila con el motor hacia atrás repartiendo las filas entre `hilos` hilos.
+// calculo: "mycin", "difuso", "probabilistico" o "lukasiewicz". Devuelve 0, o -1 si el
+// cálculo o algún objetivo no son válidos.
+int sbr_evaluar(const void* base, const double* hechos, size_t filas, size_t columnas, const int* simbolosColumna,
+                const int* objetivos, size_t numObjetivos, const char* calculo, int hilos, double* salida) {
+    const BaseCompilada& bcc = static_cast<const BaseBiblioteca*>(base)->bcc;
+    TipoCalculo tipo;
+    if (!parsearCalculo(calculo, tipo)) return -1;
+    for (size_t k = 0; k < numObjetivos; ++k) {
+        if (objetivos[k] < 0 || objetivos[k] >= static_cast<int>(bcc.simbolos.size())) return -1;
+    }
+    for (size_t j = 0; j < columnas; ++j) {
+        if (simbolosColumna[j] >= static_cast<int>(bcc.simbolos.size())) return -1;
+    }
+    std::atomic<size_t> siguiente(0);
+    const size_t bloque = 64;
+    auto trabajador = [&]() {
+        EstadoInferencia est;
+        for (size_t inicio = siguiente.fetch_add(bloque); inicio < filas; inicio = siguiente.fetch_add(bloque)) {
+            for (size_t i = inicio; i < std::min(inicio + bloque, filas); ++i) {
+                prepararEstadoFila(bcc, simbolosColumna, hechos + i * columnas, columnas, est);
+                double* fc = salida + i * numObjetivos;
+                for (size_t k = 0; k < numObjetivos; ++k) {
+                    switch (tipo) {
+                        case TipoCalculo::DIFUSO: fc[k] = evaluarSimbolo<CalculoDifuso>(bcc, est, objetivos[k]); break;
+                        case TipoCalculo::PROBABILISTICO: fc[k] = evaluarSimbolo<CalculoProbabilistico>(bcc, est, objetivos[k]); break;
+                        case TipoCalculo::LUKASIEWICZ: fc[k] = evaluarSimbolo<CalculoLukasiewicz>(bcc, est, objetivos[k]); break;
+                        case TipoCalculo::MYCIN: fc[k] = evaluarSimbolo<CalculoMycin>(bcc, est, objetivos[k]); break;
+                    }
+                }
+            }
+        }
+    };
+    std::vector<std::thread> grupo;
+    for (int h = 1; h < hilos; ++h) grupo.emplace_back(trabajador);
+    trabajador();
+    for (auto& t : grupo) t.join();
+    return 0;
+}
+
+} // extern "C"
+#endif
+
+
+// --- Función Principal para Pruebas ---
+
+// Opciones del modo de consulta
+struct OpcionesConsulta {
+    OrdenCompilacion orden = OrdenCompilacion::LOCALIDAD;
+    std::string ficheroPerfil;      // Compilar guiado por este perfil
+    std::string guardarPerfilEn;    // Registrar el perfil de las consultas (sumado al cargado) y guardarlo
+    std::string ficheroExplicacion; // Escribir el EXPLAIN ANALYZE de las consultas muestreadas
+    int muestreo = 1;               // Explicar una de cada N consultas
+    std::string ficheroEstadisticas; // CSV de estadísticas por regla
+    std::string ficheroGrafo;        // Grafo de reglas coloreado por coste (Graphviz)
+    int hilos = 1;                   // Hilos del modo lote
+    std::string ficheroAuditoria;    // Registro binario de las consultas atendidas
+    bool haciaDelante = false;       // Encadenamiento hacia delante con agenda
+    OpcionesHaciaDelante delante;    // Estrategia y plazo de la agenda
+    bool puntoFijo = false;          // Punto fijo por componentes (BCs cíclicas)
+    OpcionesPuntoFijo fijo;
+    TipoCalculo calculo = TipoCalculo::MYCIN; // Cálculo de incertidumbre del motor hacia atrás
+    bool bloques = false;            // Modo lote: evaluar los casos por bloques de kCarriles
+    bool intervalos = false;         // Cotas del FC con las hojas sin hecho desconocidas
+    bool ficherosHechos = false;     // Modo lote: los casos son un directorio de .hechos o una lista de rutas
+    unsigned profundidad = 64;       // Ficheros de hechos en vuelo a la vez (io_uring)
+    uint64_t desde = 0;              // Modo lote: casos [desde, hasta) del fichero (base 0)
+    uint64_t hasta = UINT64_MAX;
+    std::string ficheroResultados;   // Modo lote: resultados en binario por columnas en lugar de texto
+    std::vector<std::string> objetivos; // Modo lote: una columna de FC por cada uno en lugar del objetivo del caso
+};
+
+// Indica si hay que registrar contadores por regla con estas opciones
+static bool registraPerfil(const OpcionesConsulta& opciones) {
+    return !opciones.guardarPerfilEn.empty() || !opciones.ficheroEstadisticas.empty() || !opciones.ficheroGrafo.empty();
+}
+
+// Los motores alternativos (hacia delante, punto fijo, intervalos) no registran perfil ni
+// explicación ni admiten variables
+static bool admiteMotor(const BaseConocimiento& bc, const OpcionesConsulta& opciones) {
+    if (opciones.calculo != TipoCalculo::MYCIN && tieneVariables(bc)) {
+        std::cerr << "Error: --calculo no se combina con variables." << std::endl;
+        return false;
+    }
+    int alternativos = opciones.haciaDelante + opciones.puntoFijo + opciones.intervalos;
+    if (alternativos == 0) return true;
+    if (alternativos > 1 || opciones.bloques) {
+        std::cerr << "Error: --delante, --punto-fijo, --intervalos y --bloques son excluyentes." << std::endl;
+        return false;
+    }
+    if (tieneVariables(bc) || registraPerfil(opciones) || !opciones.ficheroPerfil.empty() || !opciones.ficheroExplicacion.empty()) {
+        std::cerr << "Error: " << (opciones.haciaDelante ? "--delante" : opciones.puntoFijo ? "--punto-fijo" : "--intervalos")
+                  << " no se combina con variables, perfil ni explicación." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Guarda el perfil y las estadísticas pedidas en las opciones
+static bool exportarPerfil(const BaseConocimiento& bc, const PerfilReglas& perfil, const OpcionesConsulta& opciones) {
+    if (!opciones.guardarPerfilEn.empty() && !guardarPerfil(opciones.guardarPerfilEn, bc, perfil)) return false;
+    if (!opciones.ficheroEstadisticas.empty() && !exportarEstadisticasCsv(opciones.ficheroEstadisticas, bc, perfil)) return false;
+    if (!opciones.ficheroGrafo.empty() && !exportarGrafoCoste(opciones.ficheroGrafo, bc, perfil)) return false;
+    return true;
+}
+
+// Carga la BC una vez y resuelve el objetivo de cada fichero de hechos
+int ejecutarConsultas(const std::string& ficheroReglas, const std::vector<std::string>& ficherosHechos,
+                      const OpcionesConsulta& opciones) {
+    BaseConocimiento bc;
+    if (!cargarReglas(ficheroReglas, bc)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    PerfilReglas perfil;
+    inicializarPerfil(bc, perfil);
+    if (!opciones.ficheroPerfil.empty() && !cargarPerfil(opciones.ficheroPerfil, bc, perfil)) return 1;
+    BaseCompilada bcc = compilarBase(bc, opciones.orden, opciones.ficheroPerfil.empty() ? nullptr : &perfil);
+    EstadoInferencia est;
+    if (registraPerfil(opciones)) est.perfil = &perfil;
+    if (!admiteMotor(bc, opciones)) return 1;
+    IndiceHaciaDelante indice;
+    EstadoHaciaDelante estDelante;
+    ComponentesFuertes componentes;
+    EstadoPuntoFijo estFijo;
+    EstadoIntervalos estIntervalos;
+    if (opciones.haciaDelante || opciones.puntoFijo) construirIndiceHaciaDelante(bcc, indice);
+    if (opciones.puntoFijo) calcularComponentes(bcc, componentes);
+
+    // Con variables, la BC se instancia y se compila en cada consulta
+    std::unique_ptr<BasePrimerOrden> bpo;
+    if (tieneVariables(bc)) {
+        bpo.reset(new BasePrimerOrden());
+        if (!construirBasePrimerOrden(bc, *bpo)) return 1;
+        if (registraPerfil(opciones) || !opciones.ficheroPerfil.empty() || !opciones.ficheroExplicacion.empty()) {
+            std::cerr << "Error: El perfil y la explicación no se aplican a BCs con variables." << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream salidaExplicacion;
+    if (!opciones.ficheroExplicacion.empty()) {
+        salidaExplicacion.open(opciones.ficheroExplicacion);
+        if (!salidaExplicacion.is_open()) {
+            std::cerr << "Error al crear el archivo de explicaciones: " << opciones.ficheroExplicacion << std::endl;
+            return 1;
+        }
+    }
+
+    RegistroAuditoria auditoria;
+    if (!opciones.ficheroAuditoria.empty() && !auditoria.abrir(opciones.ficheroAuditoria, bc)) return 1;
+
+    ExplicacionConsulta explicacion;
+    size_t consulta = 0;
+    for (const auto& ficheroHechos : ficherosHechos) {
+        BaseHechos bh;
+        if (!cargarHechos(ficheroHechos, bh)) {
+            std::cout << "Fallo al cargar la Base de Hechos: " << ficheroHechos << std::endl;
+            return 1;
+        }
+        bool explicar = salidaExplicacion.is_open() && consulta++ % std::max(1, opciones.muestreo) == 0;
+        if (explicar) {
+            explicacion.nodos.clear();
+            explicacion.pila.clear();
+            est.explicacion = &explicacion;
+        }
+        if (opciones.intervalos) {
+            Intervalo cotas = inferirIntervalo(opciones.calculo, bcc, bh, estIntervalos);
+            std::cout << bh.objetivo.nombre << ", FC en [" << cotas.extremo[0] << ", " << cotas.extremo[1] << "]" << std::endl;
+            continue;
+        }
+        auto llegada = std::chrono::steady_clock::now();
+        if (bpo) inferirPrimerOrden(*bpo, bh, est);
+        else if (opciones.haciaDelante) encadenarHaciaDelante(opciones.calculo, bcc, indice, bh, estDelante, opciones.delante);
+        else if (opciones.puntoFijo) evaluarPuntoFijo(opciones.calculo, bcc, componentes, indice, bh, estFijo, opciones.fijo);
+        else motorDeInferencia(opciones.calculo, bcc, bh, est);
+        if (auditoria.activo()) {
+            auditoria.registrar(bh, llegada, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - llegada).count(), bh.objetivo.factorCerteza, 0);
+        }
+        est.explicacion = nullptr;
+        if (opciones.haciaDelante && !estDelante.objetivoConcluido) {
+            std::cout << bh.objetivo.nombre << " sin concluir: plazo agotado tras " << estDelante.disparos << " disparos" << std::endl;
+            continue;
+        }
+        std::cout << bh.objetivo.nombre << ", FC = " << bh.objetivo.factorCerteza << std::endl;
+        if (opciones.haciaDelante) {
+            std::cout << "  (" << nombreEstrategia(opciones.delante.estrategia) << ": " << estDelante.disparos
+                      << " disparos, " << estDelante.descartes << " descartes, objetivo en "
+                      << estDelante.nsObjetivo / 1000.0 << " us)" << std::endl;
+        }
+        if (opciones.puntoFijo && estFijo.componentesCiclicas > 0) {
+            std::cout << "  (punto fijo: " << estFijo.componentesCiclicas << " componentes cíclicas, "
+                      << estFijo.evaluaciones << " evaluaciones";
+            if (estFijo.sinConverger > 0) std::cout << ", " << estFijo.sinConverger << " sin converger";
+            std::cout << ")" << std::endl;
+        }
+        if (explicar) escribirExplicacionJson(salidaExplicacion, bcc, bh, explicacion);
+    }
+    return exportarPerfil(bc, perfil, opciones) ? 0 : 1;
+}
+
+// Resuelve todos los casos de un fichero de casos concatenados con varios hilos. Cada hilo
+// usa su propio estado y su propio fragmento de contadores por regla, que se suman al final.
+int ejecutarLote(const std::string& ficheroReglas, const std::string& ficheroCasos, const OpcionesConsulta& opciones) {
+    BaseConocimiento bc;
+    if (!cargarReglas(ficheroReglas, bc)) {
+        std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
+        return 1;
+    }
+    std::vector<BaseHechos> casos;
+    if (opciones.ficherosHechos && (opciones.desde > 0 || opciones.hasta != UINT64_MAX)) {
+        std::cerr << "Error: --desde y --hasta se aplican a un fichero de casos, no a --ficheros." << std::endl;
+        return 1;
+    }
+    if (opciones.ficherosHechos ? !cargarFicherosHechos(ficheroCasos, opciones.profundidad, casos)
+                                : !cargarRangoCasos(ficheroCasos, opciones.desde, opciones.hasta, std::max(1, opciones.hilos), casos)) return 1;
+
+    PerfilReglas perfil;
+    inicializarPerfil(bc, perfil);
+    if (!opciones.ficheroPerfil.empty() && !cargarPerfil(opciones.ficheroPerfil, bc, perfil)) return 1;
+    BaseCompilada bcc = compilarBase(bc, opciones.orden, opciones.ficheroPerfil.empty() ? nullptr : &perfil);
+    if (!admiteMotor(bc, opciones)) return 1;
+    IndiceHaciaDelante indice;
+    ComponentesFuertes componentes;
+    if (opciones.haciaDelante || opciones.puntoFijo) construirIndiceHaciaDelante(bcc, indice);
+    if (opciones.puntoFijo) calcularComponentes(bcc, componentes);
+    std::unique_ptr<BasePrimerOrden> bpo;
+    if (tieneVariables(bc)) {
+        bpo.reset(new BasePrimerOrden());
+        if (!construirBasePrimerOrden(bc, *bpo)) return 1;
+        if (registraPerfil(opciones) || !opciones.ficheroPerfil.empty()) {
+            std::cerr << "Error: El perfil no se aplica a BCs con variables." << std::endl;
+            return 1;
+        }
+    }
+
+    PlanBloques plan;
+    if (opciones.bloques) {
+        if (bpo || opciones.haciaDelante || opciones.puntoFijo || registraPerfil(opciones)) {
+            std::cerr << "Error: --bloques sólo se aplica al encadenamiento hacia atrás sin variables ni perfil." << std::endl;
+            return 1;
+        }
+        prepararPlanBloques(bcc, plan);
+    }
+    size_t numObjetivos = opciones.objetivos.size();
+    if (numObjetivos > 0 && (bpo || opciones.haciaDelante || opciones.puntoFijo || opciones.intervalos || opciones.bloques ||
+                             !opciones.ficheroAuditoria.empty())) {
+        std::cerr << "Error: --objetivos sólo se aplica al encadenamiento hacia atrás sin variables, bloques ni auditoría." << std::endl;
+        return 1;
+    }
+    bool explicar = !opciones.ficheroExplicacion.empty();
+    if (explicar && (bpo || opciones.bloques || numObjetivos > 0)) {
+        std::cerr << "Error: --explicar no se combina con variables, --bloques ni --objetivos en el modo lote." << std::endl;
+        return 1;
+    }
+
+    RegistroAuditoria auditoria;
+    if (!opciones.ficheroAuditoria.empty() && !auditoria.abrir(opciones.ficheroAuditoria, bc)) return 1;
+
+    int hilos = std::max(1, opciones.hilos);
+    std::vector<Intervalo> cotas(opciones.intervalos ? casos.size() : 0);
+    std::vector<double> fcObjetivos(casos.size() * numObjetivos);
+    std::vector<std::string> explicaciones(explicar ? casos.size() : 0); // JSON de las consultas muestreadas
+    std::vector<PerfilReglas> fragmentos(hilos);
+    std::atomic<size_t> siguiente(0);
+    const size_t bloque = 64;
+    auto trabajador = [&](int h) {
+        EstadoInferencia est;
+        EstadoHaciaDelante estDelante;
+        EstadoPuntoFijo estFijo;
+        EstadoIntervalos estIntervalos;
+        std::unique_ptr<EstadoBloque> estBloque(opciones.bloques ? new EstadoBloque() : nullptr);
+        ExplicacionConsulta explicacion;
+        if (registraPerfil(opciones)) {
+            inicializarPerfil(bc, fragmentos[h]);
+            est.perfil = &fragmentos[h];
+        }
+        for (size_t inicio = siguiente.fetch_add(bloque); inicio < casos.size(); inicio = siguiente.fetch_add(bloque)) {
+            for (size_t i = inicio; estBloque && i < std::min(inicio + bloque, casos.size()); i += kCarriles) {
+                // Cada caso del bloque registra la duración de todo el bloque, que es lo que tardó en tener respuesta
+                int numCasos = static_cast<int>(std::min<size_t>(kCarriles, casos.size() - i));
+                auto llegada = std::chrono::steady_clock::now();
+                evaluarBloque(opciones.calculo, bcc, plan, &casos[i], numCasos, *estBloque);
+                if (!auditoria.activo()) continue;
+                int64_t duracion = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - llegada).count();
+                for (int l = 0; l < numCasos; ++l) auditoria.registrar(casos[i + l], llegada, duracion, casos[i + l].objetivo.factorCerteza, h);
+            }
+            for (size_t i = inicio; !estBloque && i < std::min(inicio + bloque, casos.size()); ++i) {
+                bool explicarCaso = explicar && i % std::max(1, opciones.muestreo) == 0;
+                if (explicarCaso) {
+                    explicacion.nodos.clear();
+                    explicacion.pila.clear();
+                    est.explicacion = &explicacion;
+                }
+                auto llegada = std::chrono::steady_clock::now();
+                if (bpo) inferirPrimerOrden(*bpo, casos[i], est);
+                else if (opciones.haciaDelante) encadenarHaciaDelante(opciones.calculo, bcc, indice, casos[i], estDelante, opciones.delante);
+                else if (opciones.puntoFijo) evaluarPuntoFijo(opciones.calculo, bcc, componentes, indice, casos[i], estFijo, opciones.fijo);
+                else if (opciones.intervalos) cotas[i] = inferirIntervalo(opciones.calculo, bcc, casos[i], estIntervalos);
+                else if (numObjetivos > 0) inferirObjetivos(opciones.calculo, bcc, casos[i], est, opciones.objetivos, &fcObjetivos[i * numObjetivos]);
+                else motorDeInferencia(opciones.calculo, bcc, casos[i], est);
+                if (auditoria.activo()) {
+                    auditoria.registrar(casos[i], llegada, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - llegada).count(), casos[i].objetivo.factorCerteza, h);
+                }
+                if (explicarCaso) {
+                    std::ostringstream json;
+                    escribirExplicacionJson(json, bcc, casos[i], explicacion);
+                    explicaciones[i] = json.str();
+                    est.explicacion = nullptr;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> grupo;
+    for (int h = 1; h < hilos; ++h) grupo.emplace_back(trabajador, h);
+    trabajador(0);
+    for (auto& t : grupo) t.join();
+
+    // Las explicaciones se escriben en el orden de los casos; la columna "explicacion" guarda su línea
+    std::vector<uint32_t> referencias;
+    if (explicar) {
+        std::ofstream salidaExplicacion(opciones.ficheroExplicacion);
+        if (!salidaExplicacion.is_open()) {
+            std::cerr << "Error al crear el archivo de explicaciones: " << opciones.ficheroExplicacion << std::endl;
+            return 1;
+        }
+        uint32_t linea = 0;
+        for (const auto& json : explicaciones) {
+            referencias.push_back(json.empty() ? kSinReferencia : linea++);
+            salidaExplicacion << json;
+        }
+    }
+
+    if (!opciones.ficheroResultados.empty()) {
+        TablaResultados tabla;
+        auto columnaFc = [&](const std::string& nombre) -> std::vector<double>& {
+            tabla.columnas.push_back(ColumnaResultados());
+            tabla.columnas.back().nombre = nombre;
+            tabla.columnas.back().fcs.reserve(casos.size());
+            return tabla.columnas.back().fcs;
+        };
+        if (numObjetivos > 0) {
+            for (size_t k = 0; k < numObjetivos; ++k) {
+                std::vector<double>& fcs = columnaFc(opciones.objetivos[k]);
+                for (size_t i = 0; i < casos.size(); ++i) fcs.push_back(fcObjetivos[i * numObjetivos + k]);
+            }
+        } else {
+            ColumnaResultados objetivo;
+            objetivo.nombre = "objetivo";
+            objetivo.tipo = TipoColumna::SIMBOLO;
+            std::unordered_map<std::string, uint32_t> indiceSimbolo;
+            for (const auto& caso : casos) {
+                auto it = indiceSimbolo.emplace(caso.objetivo.nombre, static_cast<uint32_t>(tabla.simbolos.size())).first;
+                if (it->second == tabla.simbolos.size()) tabla.simbolos.push_back(caso.objetivo.nombre);
+                objetivo.enteros.push_back(it->second);
+            }
+            tabla.columnas.push_back(std::move(objetivo));
+            if (opciones.intervalos) {
+                for (int e = 0; e < 2; ++e) {
+                    std::vector<double>& fcs = columnaFc(e ? "fc_max" : "fc_min");
+                    for (const auto& c : cotas) fcs.push_back(c.extremo[e]);
+                }
+            } else {
+                std::vector<double>& fcs = columnaFc("fc");
+                for (const auto& caso : casos) fcs.push_back(caso.objetivo.factorCerteza);
+            }
+        }
+        if (explicar) {
+            tabla.columnas.push_back(ColumnaResultados());
+            tabla.columnas.back().nombre = "explicacion";
+            tabla.columnas.back().tipo = TipoColumna::REFERENCIA;
+            tabla.columnas.back().enteros = std::move(referencias);
+        }
+        if (!guardarResultados(opciones.ficheroResultados, tabla)) return 1;
+    } else {
+        for (size_t i = 0; i < casos.size(); ++i) {
+            if (opciones.intervalos) {
+                std::cout << casos[i].objetivo.nombre << ", FC en [" << cotas[i].extremo[0] << ", " << cotas[i].extremo[1] << "]\n";
+            } else if (numObjetivos > 0) {
+                for (size_t k = 0; k < numObjetivos; ++k) {
+                    std::cout << (k ? "; " : "") << opciones.objetivos[k] << ", FC = " << fcObjetivos[i * numObjetivos + k];
+                }
+                std::cout << '\n';
+            } else {
+                std::cout << casos[i].objetivo.nombre << ", FC = " << casos[i].objetivo.factorCerteza << '\n';
+            }
+        }
+        std::cout.flush();
+    }
+
+    if (registraPerfil(opciones)) {
+        for (const auto& fragmento : fragmentos) {
+            for (size_t r = 0; r < bc.reglas.size(); ++r) acumularContadores(perfil.reglas[r], fragmento.reglas[r]);
+        }
+    }
+    return exportarPerfil(bc, perfil, opciones) ? 0 : 1;
+}
+
+void imprimirUso(const char* programa) {
+    std::cerr << "Uso: " << programa << "                           (prueba con Prueba-1)" << std::endl;
+    std::cerr << "     " << programa << " [opciones] <reglas> <hechos>..." << std::endl;
+    std::cerr << "     " << programa << " [opciones] --lote <reglas> <casos>" << std::endl;
+    std::cerr << "     " << programa << " --bench [--reglas N] [--consultas N] [--semilla N] [--repeticiones N] [--guardar-bench <fichero>]" << std::endl;
+    std::cerr << "     " << programa << " --comparar-bench <base> <nuevo> [--umbral %]" << std::endl;
+    std::cerr << "     " << programa << " --diferencial [--casos N] [--semilla N] [--tolerancia X]" << std::endl;
+    std::cerr << "     " << programa << " --servidor <socket> <reglas>" << std::endl;
+    std::cerr << "     " << programa << " --carga <socket> <casos> [--qps N] [--duracion S] [--conexiones N] [--histograma <fichero>]" << std::endl;
+    std::cerr << "     " << programa << " --reproducir <reglas> <auditoria> [--ritmo seguido|original]" << std::endl;
+    std::cerr << "     " << programa << " --sombra <reglas> <reglas-nuevas> <casos> [--hilos N] [--tolerancia X] [--calculo C]" << std::endl;
+    std::cerr << "     " << programa << " --reevaluar <reglas> <reglas-nuevas> <casos> <resultados> <salida> [--calculo C]" << std::endl;
+    std::cerr << "     " << programa << " --entrenar <reglas> <casos> <etiquetas> <salida> [--epocas N] [--minilote N] [--tasa X] [--hilos N] [--semilla N]" << std::endl;
+    std::cerr << "     " << programa << " --indexar <casos>                (escribe <casos>.idx)" << std::endl;
+    std::cerr << "     " << programa << " --leer-resultados <fichero>      (fichero de --resultados como CSV)" << std::endl;
+    std::cerr << "     " << programa << " --generar-bc <salida> [--reglas N] [--semilla N]" << std::endl;
+    std::cerr << "     " << programa << " --generar-casos <reglas> <salida> [--casos N] [--semilla N]" << std::endl;
+    std::cerr << "Opciones:" << std::endl;
+    std::cerr << "  --orden archivo|localidad   Numeración de símbolos y reglas al compilar (por defecto localidad)" << std::endl;
+    std::cerr << "  --perfil <fichero>          Compila la BC guiada por un perfil guardado" << std::endl;
+    std::cerr << "  --guardar-perfil <fichero>  Registra el perfil de las consultas y lo guarda" << std::endl;
+    std::cerr << "  --explicar <fichero>        Escribe el árbol de subobjetivos de cada consulta en JSON" << std::endl;
+    std::cerr << "  --muestreo N                Con --explicar, explica sólo una de cada N consultas" << std::endl;
+    std::cerr << "  --estadisticas <fichero>    Exporta evaluaciones, disparos y tiempo por regla en CSV" << std::endl;
+    std::cerr << "  --grafo <fichero>           Exporta el grafo de reglas coloreado por coste (Graphviz)" << std::endl;
+    std::cerr << "  --hilos N                   Hilos del modo lote" << std::endl;
+    std::cerr << "  --auditoria <fichero>       Registra cada consulta atendida (hechos, objetivo, tiempos) en binario" << std::endl;
+    std::cerr << "  --delante                   Encadenamiento hacia delante con agenda en lugar de hacia atrás" << std::endl;
+    std::cerr << "  --estrategia E              Agenda: prioridad (por defecto), recencia, especificidad o certeza" << std::endl;
+    std::cerr << "  --plazo MS                  Con --delante, abandona la consulta tras MS milisegundos" << std::endl;
+    std::cerr << "  --calculo C                 mycin (por defecto), difuso, probabilistico o lukasiewicz" << std::endl;
+    std::cerr << "  --bloques                   Modo lote: evalúa los casos de " << kCarriles << " en " << kCarriles << " (SoA, vectorizable)" << std::endl;
+    std::cerr << "  --ficheros                  Modo lote: <casos> es un directorio de .hechos o una lista de rutas" << std::endl;
+    std::cerr << "  --profundidad N             Con --ficheros, ficheros leídos a la vez con io_uring (por defecto 64)" << std::endl;
+    std::cerr << "  --desde N, --hasta N        Modo lote: sólo los casos N..M (desde 1); con <casos>.idx no se recorre el resto" << std::endl;
+    std::cerr << "  --resultados <fichero>      Modo lote: resultados en binario por columnas en lugar de texto" << std::endl;
+    std::cerr << "  --objetivos a,b,...         Modo lote: el FC de cada uno de estos símbolos en lugar del objetivo del caso" << std::endl;
+    std::cerr << "  --intervalos                Acota el FC del objetivo con las hojas sin hecho desconocidas" << std::endl;
+    std::cerr << "  --punto-fijo                Evalúa los ciclos de reglas por iteración de punto fijo" << std::endl;
+    std::cerr << "  --tolerancia X              Con --punto-fijo, cambio mínimo que propaga una actualización" << std::endl;
+    std::cerr << "  --max-iteraciones N         Con --punto-fijo, evaluaciones por símbolo de un ciclo antes de rendirse" << std::endl;
+}
+
+#if !defined(SBR_FUZZ) && !defined(SBR_BIBLIOTECA)
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        std::vector<std::string> posicionales;
+        OpcionesConsulta opciones;
+        bool bench = false, lote = false, diferencial = false;
+        int numCasos = 1000;
+        double tolerancia = 1e-9;
+        int numReglas = 200000, numConsultas = 5000, repeticiones = 10;
+        std::string guardarBenchEn;
+        bool compararBench = false;
+        double umbral = 5.0;
+        bool servidor = false, carga = false, generarBc = false, generarCasos = false;
+        bool reproducir = false, ritmoOriginal = false;
+        bool entrenar = false, sombra = false, reevaluar = false, indexar = false, leerResultados = false;
+        OpcionesEntrenamiento entrenamiento;
+        double qps = 1000, duracion = 10;
+        int conexiones = 4;
+        std::string ficheroHistograma;
+        unsigned semilla = 1;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hayValor = i + 1 < argc;
+            try {
+                if (arg == "--bench") {
+                    bench = true;
+                } else if (arg == "--repeticiones" && hayValor) {
+                    repeticiones = std::stoi(argv[++i]);
+                } else if (arg == "--guardar-bench" && hayValor) {
+                    guardarBenchEn = argv[++i];
+                } else if (arg == "--comparar-bench") {
+                    compararBench = true;
+                } else if (arg == "--umbral" && hayValor) {
+                    umbral = std::stod(argv[++i]);
+                } else if (arg == "--servidor") {
+                    servidor = true;
+                } else if (arg == "--carga") {
+                    carga = true;
+                } else if (arg == "--qps" && hayValor) {
+                    qps = std::stod(argv[++i]);
+                } else if (arg == "--duracion" && hayValor) {
+                    duracion = std::stod(argv[++i]);
+                } else if (arg == "--conexiones" && hayValor) {
+                    conexiones = std::stoi(argv[++i]);
+                } else if (arg == "--histograma" && hayValor) {
+                    ficheroHistograma = argv[++i];
+                } else if (arg == "--auditoria" && hayValor) {
+                    opciones.ficheroAuditoria = argv[++i];
+                } else if (arg == "--delante") {
+                    opciones.haciaDelante = true;
+                } else if (arg == "--estrategia" && hayValor) {
+                    if (!parsearEstrategia(argv[++i], opciones.delante.estrategia)) { imprimirUso(argv[0]); return 1; }
+                } else if (arg == "--plazo" && hayValor) {
+                    opciones.delante.plazoNs = static_cast<int64_t>(std::stod(argv[++i]) * 1e6);
+                } else if (arg == "--calculo" && hayValor) {
+                    if (!parsearCalculo(argv[++i], opciones.calculo)) { imprimirUso(argv[0]); return 1; }
+                } else if (arg == "--intervalos") {
+                    opciones.intervalos = true;
+                } else if (arg == "--ficheros") {
+                    opciones.ficherosHechos = true;
+                } else if (arg == "--profundidad" && hayValor) {
+                    opciones.profundidad = static_cast<unsigned>(std::stoul(argv[++i]));
+                } else if (arg == "--desde" && hayValor) {
+                    opciones.desde = std::max<uint64_t>(1, std::stoull(argv[++i])) - 1;
+                } else if (arg == "--hasta" && hayValor) {
+                    opciones.hasta = std::stoull(argv[++i]);
+                } else if (arg == "--indexar") {
+                    indexar = true;
+                } else if (arg == "--resultados" && hayValor) {
+                    opciones.ficheroResultados = argv[++i];
+                } else if (arg == "--objetivos" && hayValor) {
+                    std::istringstream lista(argv[++i]);
+                    std::string objetivo;
+                    while (std::getline(lista, objetivo, ',')) {
+                        if (!objetivo.empty()) opciones.objetivos.push_back(objetivo);
+                    }
+                } else if (arg == "--leer-resultados") {
+                    leerResultados = true;
+                } else if (arg == "--bloques") {
+                    opciones.bloques = true;
+                } else if (arg == "--punto-fijo") {
+                    opciones.puntoFijo = true;
+                } else if (arg == "--max-iteraciones" && hayValor) {
+                    opciones.fijo.maxIteraciones = std::stoi(argv[++i]);
+                } else if (arg == "--sombra") {
+                    sombra = true;
+                } else if (arg == "--reevaluar") {
+                    reevaluar = true;
+                } else if (arg == "--entrenar") {
+                    entrenar = true;
+                } else if (arg == "--epocas" && hayValor) {
+                    entrenamiento.epocas = std::stoi(argv[++i]);
+                } else if (arg == "--minilote" && hayValor) {
+                    entrenamiento.minilote = std::stoi(argv[++i]);
+                } else if (arg == "--tasa" && hayValor) {
+                    entrenamiento.tasa = std::stod(argv[++i]);
+                } else if (arg == "--reproducir") {
+                    reproducir = true;
+                } else if (arg == "--ritmo" && hayValor) {
+                    std::string valor = argv[++i];
+                    if (valor == "original") ritmoOriginal = true;
+                    else if (valor == "seguido") ritmoOriginal = false;
+                    else { imprimirUso(argv[0]); return 1; }
+                } else if (arg == "--generar-bc") {
+                    generarBc = true;
+                } else if (arg == "--generar-casos") {
+                    generarCasos = true;
+                } else if (arg == "--lote") {
+                    lote = true;
+                } else if (arg == "--diferencial") {
+                    diferencial = true;
+                } else if (arg == "--casos" && hayValor) {
+                    numCasos = std::stoi(argv[++i]);
+                } else if (arg == "--tolerancia" && hayValor) {
+                    tolerancia = std::stod(argv[++i]);
+                    opciones.fijo.tolerancia = tolerancia;
+                } else if (arg == "--estadisticas" && hayValor) {
+                    opciones.ficheroEstadisticas = argv[++i];
+                } else if (arg == "--grafo" && hayValor) {
+                    opciones.ficheroGrafo = argv[++i];
+                } else if (arg == "--hilos" && hayValor) {
+                    opciones.hilos = std::stoi(argv[++i]);
+                } else if (arg == "--orden" && hayValor) {
+                    std::string valor = argv[++i];
+                    if (valor == "archivo") opciones.orden = OrdenCompilacion::ARCHIVO;
+                    else if (valor == "localidad") opciones.orden = OrdenCompilacion::LOCALIDAD;
+                    else { imprimirUso(argv[0]); return 1; }
+                } else if (arg == "--perfil" && hayValor) {
+                    opciones.ficheroPerfil = argv[++i];
+                } else if (arg == "--guardar-perfil" && hayValor) {
+                    opciones.guardarPerfilEn = argv[++i];
+                } else if (arg == "--explicar" && hayValor) {
+                    opciones.ficheroExplicacion = argv[++i];
+                } else if (arg == "--muestreo" && hayValor) {
+                    opciones.muestreo = std::stoi(argv[++i]);
+                } else if (arg == "--reglas" && hayValor) {
+                    numReglas = std::stoi(argv[++i]);
+                } else if (arg == "--consultas" && hayValor) {
+                    numConsultas = std::stoi(argv[++i]);
+                } else if (arg == "--semilla" && hayValor) {
+                    semilla = static_cast<unsigned>(std::stoul(argv[++i]));
+                } else if (arg.rfind("--", 0) == 0) {
+                    imprimirUso(argv[0]);
+                    return 1;
+                } else {
+                    posicionales.push_back(arg);
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Error: Valor inválido para " << arg << std::endl;
+                return 1;
+            }
+        }
+
+        if (bench) {
+            std::cout << "Benchmark: " << numReglas << " reglas, " << numConsultas << " consultas, "
+                      << repeticiones << " repeticiones" << std::endl;
+            std::vector<ResultadoBench> resultados = medirBenchmarks(numReglas, numConsultas, semilla, repeticiones);
+            imprimirBenchmarks(resultados);
+            return guardarBenchEn.empty() || guardarBenchmarks(guardarBenchEn, resultados) ? 0 : 1;
+        }
+        if (compararBench) {
+            if (posicionales.size() != 2) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            int regresiones = compararBenchmarks(posicionales[0], posicionales[1], umbral);
+            return regresiones == 0 ? 0 : 1;
+        }
+        if (sombra) {
+            if (posicionales.size() != 3) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            return ejecutarSombra(posicionales[0], posicionales[1], posicionales[2], opciones.orden, opciones.calculo,
+                                  opciones.hilos, tolerancia);
+        }
+        if (reevaluar) {
+            if (posicionales.size() != 5) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            return reevaluarCasos(posicionales[0], posicionales[1], posicionales[2], posicionales[3], posicionales[4], opciones.orden,
+                                  opciones.calculo);
+        }
+        if (entrenar) {
+            if (posicionales.size() != 4) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            if (opciones.calculo != TipoCalculo::MYCIN) { // El gradiente se deriva de la combinación MYCIN
+                std::cerr << "Error: --entrenar sólo admite --calculo mycin." << std::endl;
+                return 1;
+            }
+            entrenamiento.hilos = opciones.hilos;
+            entrenamiento.semilla = semilla;
+            return entrenarReglas(posicionales[0], posicionales[1], posicionales[2], posicionales[3], entrenamiento);
+        }
+        if (indexar) {
+            if (posicionales.size() != 1) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            return indexarCasos(posicionales[0]);
+        }
+        if (leerResultados) {
+            if (posicionales.size() != 1) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            return imprimirResultados(posicionales[0]);
+        }
+        if (generarBc) {
+            if (posicionales.size() != 1) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            return generarFicheroReglas(posicionales[0], numReglas, semilla) ? 0 : 1;
+        }
+        if (servidor || carga || generarCasos || reproducir) {
+            if (posicionales.size() != 2) {
+                imprimirUso(argv[0]);
+                return 1;
+            }
+            if (servidor) return ejecutarServidor(posicionales[0], posicionales[1], opciones.orden, opciones.ficheroAuditoria);
+            if (reproducir) return reproducirAuditoria(posicionales[0], posicionales[1], ritmoOriginal, opciones.orden);
+            if (carga) return ejecutarGeneradorCarga(posicionales[0], posicionales[1], qps, duracion, conexiones, ficheroHistograma);
+            return generarFicheroCasos(posicionales[0], posicionales[1], numCasos, semilla) ? 0 : 1;
+        }
+        if (diferencial) return ejecutarPruebasDiferenciales(numCasos, semilla, tolerancia) == 0 ? 0 : 1;
+        if (posicionales.size() < 2 || (lote && posicionales.size() != 2)) {
+            imprimirUso(argv[0]);
+            return 1;
+        }
+        if (lote) return ejecutarLote(posicionales[0], posicionales[1], opciones);
+        return ejecutarConsultas(posicionales[0],
+                                 std::vector<std::string>(posicionales.begin() + 1, posicionales.end()), opciones);
+    }
+
+    BaseConocimiento bc;
+    BaseHechos bh;
+
+    // Crear ficheros de prueba (esto es solo para que el ejemplo sea autocontenido)
+    // En un caso real, estos ficheros existirían previamente.
+    std::ofstream reglasFile("Prueba-1.reglas");
+    if (reglasFile.is_open()) {
+        reglasFile << "4\n";
+        reglasFile << "R1: Si h2 o h3 Entonces h1, FC = 0.5\n";
+        reglasFile << "R2: Si h4 Entonces h1, FC = 1\n";
+        reglasFile << "R3: Si h5 y h6 Entonces h3, FC = 0.7\n";
+        reglasFile << "R4: Si h7 Entonces h3, FC = -0.5\n";
+        reglasFile.close();
+    } else {
+        std::cerr << "No se pudo crear Prueba-1.reglas para el test." << std::endl;
+        return 1;
+    }
+
+    std::ofstream hechosFile("Prueba-1.hechos");
+    if (hechosFile.is_open()) {
+        hechosFile << "5\n";
+        hechosFile << "h2, FC = 0.3\n";
+        hechosFile << "h4, FC = 0.6\n";
+        hechosFile << "h5, FC = 0.6\n";
+        hechosFile << "h6, FC = 0.9\n";
+        hechosFile << "h7, FC = 0.5\n";
+        hechosFile << "Objetivo\n";
+        hechosFile << "h1\n";
+        hechosFile.close();
+    } else {
+        std::cerr << "No se pudo crear Prueba-1.hechos para el test." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Cargando Base de Conocimiento desde Prueba-1.reglas..." << std::endl;
+    if (cargarReglas("Prueba-1.reglas", bc)) {
+        std::cout << "Base de Conocimiento cargada exitosamente." << std::endl;
+        imprimirBaseConocimiento(bc);
     } else {
         std::cout << "Fallo al cargar la Base de Conocimiento." << std::endl;
         return 1;
@@ -436,8 +7273,12 @@ int main() {
         return 1;
     }
 
-    // Aquí iría la llamada al motor de inferencia en el futuro
-    // motorDeInferencia(bc, bh);
+    std::cout << "\nMotor de inferencia..." << std::endl;
+    BaseCompilada bcc = compilarBase(bc);
+    EstadoInferencia est;
+    motorDeInferencia(bcc, bh, est);
+    std::cout << "Objetivo " << bh.objetivo.nombre << ", FC = " << bh.objetivo.factorCerteza << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
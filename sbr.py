@@ -0,0 +1,82 @@
+"""Enlace de Python para el motor de sbr.cpp.
+
+Usa la biblioteca compartida compilada con:
+
+    g++ -std=c++17 -O2 -shared -fPIC -pthread -DSBR_BIBLIOTECA sbr.cpp -o libsbr.so
+
+Ejemplo:
+
+    import numpy as np, sbr
+    bc = sbr.BaseConocimiento("Prueba-1.reglas")
+    casos = np.array([[0.3, 0.6, 0.6, 0.9, 0.5],
+                      [np.nan, np.nan, 1.0, 1.0, np.nan]])   # NaN: sin hecho en ese caso
+    fc = bc.evaluar(casos, ["h2", "h4", "h5", "h6", "h7"], ["h1"], hilos=4)   # [[0.66], [0.35]]
+
+Si la matriz de casos ya es float64 contigua por filas no se copia, y el resultado se
+escribe directamente en el array devuelto. El GIL se libera mientras evalúa el motor.
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+_RUTA = os.environ.get("SBR_BIBLIOTECA", os.path.join(os.path.dirname(os.path.abspath(__file__)), "libsbr.so"))
+_lib = ctypes.CDLL(_RUTA)  # CDLL (no PyDLL): ctypes suelta el GIL durante cada llamada
+
+_lib.sbr_cargar.restype = ctypes.c_void_p
+_lib.sbr_cargar.argtypes = [ctypes.c_char_p]
+_lib.sbr_liberar.restype = None
+_lib.sbr_liberar.argtypes = [ctypes.c_void_p]
+_lib.sbr_num_simbolos.restype = ctypes.c_int
+_lib.sbr_num_simbolos.argtypes = [ctypes.c_void_p]
+_lib.sbr_nombre_simbolo.restype = ctypes.c_char_p
+_lib.sbr_nombre_simbolo.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_lib.sbr_simbolo.restype = ctypes.c_int
+_lib.sbr_simbolo.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_lib.sbr_evaluar.restype = ctypes.c_int
+_lib.sbr_evaluar.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p,
+                             ctypes.c_void_p, ctypes.c_size_t, ctypes.c_char_p, ctypes.c_int, ctypes.c_void_p]
+
+
+class BaseConocimiento:
+    """BC cargada y compilada una vez; evaluar() resuelve matrices de casos con ella."""
+
+    def __init__(self, fichero_reglas):
+        self._base = _lib.sbr_cargar(os.fsencode(fichero_reglas))
+        if not self._base:
+            raise ValueError("No se pudo cargar la BC: %s" % fichero_reglas)
+
+    def __del__(self):
+        if getattr(self, "_base", None):
+            _lib.sbr_liberar(self._base)
+            self._base = None
+
+    @property
+    def simbolos(self):
+        return [_lib.sbr_nombre_simbolo(self._base, s).decode() for s in range(_lib.sbr_num_simbolos(self._base))]
+
+    def simbolo(self, nombre):
+        """Id del símbolo en la BC, o -1 si no aparece en ella."""
+        return _lib.sbr_simbolo(self._base, nombre.encode())
+
+    def evaluar(self, casos, columnas, objetivos, calculo="mycin", hilos=1):
+        """FCs de los objetivos (filas x objetivos) para una matriz de casos (filas x columnas).
+
+        Cada columna es el FC de un hecho, o NaN si el caso no lo tiene. Las columnas que no
+        aparecen en la BC se ignoran; un objetivo que no aparece en ella es un error.
+        """
+        casos = np.ascontiguousarray(casos, dtype=np.float64)
+        if casos.ndim != 2 or casos.shape[1] != len(columnas):
+            raise ValueError("casos debe ser una matriz con una columna por nombre de columnas")
+        ids_columnas = np.array([self.simbolo(c) for c in columnas], dtype=np.intc)
+        ids_objetivos = np.array([self.simbolo(o) for o in objetivos], dtype=np.intc)
+        for nombre, s in zip(objetivos, ids_objetivos):
+            if s < 0:
+                raise KeyError("Objetivo fuera de la BC: %s" % nombre)
+        salida = np.empty((casos.shape[0], len(objetivos)), dtype=np.float64)
+        if _lib.sbr_evaluar(self._base, casos.ctypes.data, casos.shape[0], casos.shape[1], ids_columnas.ctypes.data,
+                            ids_objetivos.ctypes.data, len(objetivos), calculo.encode(), max(1, hilos),
+                            salida.ctypes.data) != 0:
+            raise ValueError("Cálculo de incertidumbre desconocido: %s" % calculo)
+        return salida